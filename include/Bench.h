@@ -0,0 +1,350 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <algorithm>
+#include <random>
+#include <list>
+#include <mutex>
+#include <condition_variable>
+
+#include "GestureQueue.h"
+#include "StageStats.h"
+#include "SpatialGrid.h"
+#include "SequenceStore.h"
+#include "ProximityLinker.h"
+#include "StrokeKernel.h"
+#include "Scheduler.h"
+#include "Tangible.h"
+#include "cinder/BSpline.h"
+
+#define BENCH_QUEUE_SIZE 64 // as GESTURE_QUEUE_SIZE and TRACE_QUEUE_SIZE
+#define BENCH_TABLE_WIDTH (1.0f / 0.75f) // table space, as TheApp::tuioToTable()
+#define BENCH_GRID_CELL_SIZE 0.125f // as GRID_CELL_SIZE
+#define BENCH_LINK_THRESHOLD 0.01f // as LINK_THRESHOLD
+#define BENCH_LINK_RADIUS (150.0f / 768.0f) // as update() in a 768 px high window
+#define BENCH_BOARD_RADIUS 0.05f
+#define BENCH_STEP_LENGTH 0.01 // s, short so that many steps fit in a few seconds
+#define BENCH_SCHEDULER_LOOKAHEAD 20 // ms, as SCHEDULER_LOOKAHEAD
+#define BENCH_SCHEDULER_BUDGET 4.0 // ms the p99 lateness may come to by default
+
+namespace SecondStudy {
+
+	// Micro-benchmarks of the pieces of the pipeline that can be timed on their own, run by
+	// the headless build with --bench name [options]. Each prints a table of StageStats.
+
+	struct BenchStamp {
+		StageStats::Clock::time_point pushed;
+	};
+
+	// Several producers push into one GestureQueue as fast as they can, as the TUIO and trace
+	// threads do, and one consumer pops, as the gesture thread does. Times each element from
+	// its push() to the waitPop() that hands it over, and counts the pushes that found the
+	// ring full. The producers pause every so often so the consumer goes to sleep at times
+	// and the wake-up path is timed too.
+	//   --bench queue [producers] [per producer]
+	inline int benchQueue(int producers, long count) {
+		GestureQueue<BenchStamp, BENCH_QUEUE_SIZE> queue;
+		StageStats latency;
+		std::atomic<long> full(0);
+
+		std::thread consumer([&] {
+			BenchStamp s;
+			while(queue.waitPop(s)) {
+				latency.add(StageStats::Clock::now() - s.pushed);
+			}
+		});
+
+		StageStats::Clock::time_point start = StageStats::Clock::now();
+		std::vector<std::thread> threads;
+		for(int p = 0; p < producers; p++) {
+			threads.push_back(std::thread([&] {
+				long rejected = 0;
+				for(long i = 0; i < count; i++) {
+					BenchStamp s;
+					s.pushed = StageStats::Clock::now();
+					while(!queue.push(s)) {
+						rejected++;
+						std::this_thread::yield();
+						s.pushed = StageStats::Clock::now();
+					}
+					if(i % 1024 == 1023) {
+						std::this_thread::sleep_for(std::chrono::microseconds(200));
+					}
+				}
+				full.fetch_add(rejected);
+			}));
+		}
+		for(auto& t : threads) {
+			t.join();
+		}
+		queue.close();
+		consumer.join();
+		double wall = std::chrono::duration<double>(StageStats::Clock::now() - start).count();
+
+		std::ostream& out = std::cout;
+		out << std::fixed << std::setprecision(3);
+		out << "producers     " << producers << std::endl;
+		out << "elements      " << producers * count << std::endl;
+		out << "full pushes   " << full.load() << std::endl;
+		out << "elements/s    " << (wall > 0.0 ? producers * count / wall : 0.0) << std::endl;
+		out << std::endl;
+		StageStats::header(out);
+		latency.print(out, "push to pop");
+		return 0;
+	}
+
+	// The per-frame pass of the ProximityLinker, as update() runs it with auto link on:
+	// tangibles scattered over the table, a few of them moved every frame, most by a
+	// little and some across the table, and every moved one put in the grid and handed
+	// to the linker before the pass is timed.
+	//   --bench link [tangibles] [frames]
+	inline int benchLink(int tangibles, long frames) {
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> x(0.0f, BENCH_TABLE_WIDTH), y(0.0f, 1.0f), nudge(-0.02f, 0.02f);
+		std::uniform_int_distribution<int> pick(1, tangibles);
+
+		SpatialGrid grid(ci::Vec2f(BENCH_TABLE_WIDTH, 1.0f), BENCH_GRID_CELL_SIZE);
+		SequenceStore sequences;
+		ProximityLinker linker(BENCH_LINK_THRESHOLD);
+		std::vector<ci::Vec2f> positions(tangibles + 1);
+		// Fiducial 0 is the play mode token, which never takes part
+		for(int id = 1; id <= tangibles; id++) {
+			positions[id] = ci::Vec2f(x(random), y(random));
+			sequences.add(id, nullptr);
+			grid.insert(id, positions[id], BENCH_BOARD_RADIUS);
+			linker.moved(id, positions[id]);
+		}
+
+		StageStats pass;
+		long deltas = 0;
+		long joins = 0;
+		std::vector<int> joined;
+		for(long f = 0; f < frames; f++) {
+			int moving = std::max(tangibles / 10, 1);
+			for(int i = 0; i < moving; i++) {
+				int id = pick(random);
+				if(i == 0 && f % 30 == 0) {
+					positions[id] = ci::Vec2f(x(random), y(random));
+				} else {
+					positions[id] += ci::Vec2f(nudge(random), nudge(random));
+				}
+				grid.insert(id, positions[id], BENCH_BOARD_RADIUS);
+				linker.moved(id, positions[id]);
+			}
+			joined.clear();
+			StageStats::Clock::time_point start = StageStats::Clock::now();
+			deltas += linker.pass(sequences, grid, BENCH_LINK_RADIUS, joined).size();
+			pass.add(StageStats::Clock::now() - start);
+			joins += joined.size();
+		}
+
+		std::ostream& out = std::cout;
+		out << std::fixed << std::setprecision(3);
+		out << "tangibles     " << tangibles << std::endl;
+		out << "frames        " << frames << std::endl;
+		out << "deltas        " << deltas << std::endl;
+		out << "joins         " << joins << std::endl;
+		out << std::endl;
+		StageStats::header(out);
+		pass.print(out, "linker pass");
+		return 0;
+	}
+
+	// A musical stroke of n points wandering over a board at angle, in TUIO space
+	inline std::vector<ci::Vec2f> benchStroke(std::mt19937& random, size_t n, ci::Vec2f centre, float angle) {
+		std::uniform_real_distribution<float> step(-0.004f, 0.004f);
+		std::vector<ci::Vec2f> points;
+		ci::Vec2f p = centre;
+		ci::Vec2f along(cos(angle) * 0.75f, sin(angle));
+		for(size_t i = 0; i < n; i++) {
+			p += along * (0.15f / n) + ci::Vec2f(step(random), step(random));
+			points.push_back(p);
+		}
+		return points;
+	}
+
+	// How musicalStroke() took a stroke onto a board before StrokeKernel: every point
+	// through the offset/aspect/rotate chain one Vec2f at a time, copied twice, fitted
+	// with a BSpline2f and sampled along its length.
+	inline void oldMusicalStroke(const std::vector<ci::Vec2f>& points, ci::Vec2f offset, float angle, ci::Vec2f boardSize, std::list<ci::Vec2f>& out) {
+		std::vector<ci::Vec2f> qs;
+		for(auto p : points) {
+			ci::Vec2f q(p);
+			q -= offset;
+			q /= ci::Vec2f(0.75, 1.0f);
+			q.rotate(-angle);
+			q *= ci::Vec2f(0.75, 1.0);
+			qs.push_back(q);
+		}
+		std::vector<ci::Vec2f> tqs;
+		for(auto p : qs) {
+			tqs.push_back(p * ci::Vec2f(640.0f, 480.0f));
+		}
+		if(tqs.size() > 2) {
+			ci::BSpline2f l(tqs, std::min((int)tqs.size(), 3), false, true);
+			float totalLength = l.getLength(0, 1);
+			float step = sqrt(totalLength);
+			out.push_back((l.getPosition(0.0f) / ci::Vec2f(640.0f, 480.0f)) / (boardSize / ci::Vec2f(640.0f, 480.0f)));
+			for(float p = 0.0f; p <= totalLength; p += step) {
+				ci::Vec2f lp(l.getPosition(l.getTime(p)));
+				lp /= ci::Vec2f(640.0f, 480.0f);
+				out.push_back(lp / (boardSize / ci::Vec2f(640.0f, 480.0f)));
+			}
+			out.push_back((l.getPosition(1.0f) / ci::Vec2f(640.0f, 480.0f)) / (boardSize / ci::Vec2f(640.0f, 480.0f)));
+		}
+	}
+
+	// The same strokes through the old way of musicalStroke() and through StrokeKernel
+	// as musicalStroke() uses it now, from 10 to 2000 points. Both get the same points;
+	// live, the kernel gets the trace already smoothed, which the old way did itself.
+	//   --bench stroke [strokes per length]
+	inline int benchStroke(long count) {
+		static const size_t lengths[] = { 10, 50, 100, 250, 500, 1000, 2000 };
+		static const size_t LENGTHS = sizeof(lengths) / sizeof(lengths[0]);
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> angles(0.0f, 6.2831853f);
+		Tangible layout;
+		ci::Vec2f boardSize = layout.board.getSize();
+		StrokeKernel kernel;
+		std::list<ci::Vec2f> stroke;
+		std::vector<ci::Vec2f> samples;
+		std::vector<int> notes;
+		double sampled[2] = { 0.0, 0.0 };
+
+		std::ostream& out = std::cout;
+		out << std::fixed << std::setprecision(3);
+#if defined(STROKE_KERNEL_SSE)
+		out << "kernel        SSE" << std::endl;
+#else
+		out << "kernel        scalar" << std::endl;
+#endif
+		out << "strokes       " << count << " per length" << std::endl;
+		out << std::endl;
+		StageStats::header(out);
+		for(size_t length : lengths) {
+			StageStats old, now;
+			for(long r = 0; r < count; r++) {
+				float angle = angles(random);
+				ci::Vec2f position(0.5f, 0.5f);
+				// As musicalStroke() works it out
+				ci::Vec2f offset = layout.board.getCenter() / 480.0f;
+				offset.rotate(angle);
+				offset *= ci::Vec2f(0.75f, 1.0f);
+				offset += position;
+				std::vector<ci::Vec2f> points = benchStroke(random, length, offset, angle);
+
+				stroke.clear();
+				StageStats::Clock::time_point start = StageStats::Clock::now();
+				oldMusicalStroke(points, offset, angle, boardSize, stroke);
+				old.add(StageStats::Clock::now() - start);
+				sampled[0] += stroke.size();
+
+				start = StageStats::Clock::now();
+				float k = 480.0f, cs = cos(angle), sn = sin(angle);
+				float t[6] = {
+					k * cs / 0.75f, k * sn, 0.0f,
+					-k * sn / 0.75f, k * cs, 0.0f
+				};
+				t[2] = -(t[0] * offset.x + t[1] * offset.y);
+				t[5] = -(t[3] * offset.x + t[4] * offset.y);
+				kernel.clear();
+				kernel.append(points.data(), points.size());
+				notes.assign(layout.size().first, 1000);
+				samples.clear();
+				if(kernel.size() > 2) {
+					kernel.transform(t);
+					kernel.resample(sqrt(kernel.length()), boardSize, layout.size().second, samples, notes);
+				}
+				now.add(StageStats::Clock::now() - start);
+				sampled[1] += samples.size();
+			}
+			std::string name = std::to_string(length);
+			old.print(out, ("old " + name).c_str());
+			now.print(out, ("kernel " + name).c_str());
+		}
+		out << std::endl;
+		out << "samples/stroke " << sampled[0] / (count * LENGTHS) << " old, " << sampled[1] / (count * LENGTHS) << " kernel" << std::endl;
+		return 0;
+	}
+
+	// The scheduler the app plays with, on its own thread and the wall clock, for steps
+	// at a time, each with a bar's worth of notes. Every step is timed from when it
+	// should have gone out to when the emit callback got it. Fails if the p99 of that
+	// comes to more than budget ms. The p99 is the top of its histogram bucket, so it
+	// reads a little high.
+	//   --bench scheduler [steps] [budget ms]
+	inline int benchScheduler(long steps, double budget) {
+		typedef ThreadedScheduler::Clock Clock;
+		StageStats lateness;
+		std::mutex mutex;
+		std::condition_variable cv;
+		long emitted = 0;
+		ThreadedScheduler scheduler(
+			[](int step, Clock::time_point when, std::vector<int>& notes) {
+				for(int i = 0; i < 8; i++) {
+					notes.push_back(60 + (step + i) % 12);
+				}
+			},
+			[&](Clock::time_point when, const std::vector<int>& notes) {
+				lateness.add(Clock::now() - when);
+				std::lock_guard<std::mutex> lock(mutex);
+				emitted++;
+				cv.notify_all();
+			},
+			std::chrono::milliseconds(BENCH_SCHEDULER_LOOKAHEAD));
+		scheduler.start(BENCH_STEP_LENGTH);
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [&] { return emitted >= steps; });
+		}
+		scheduler.stop();
+
+		double p99 = lateness.percentile(0.99) / 1000.0;
+		std::ostream& out = std::cout;
+		out << std::fixed << std::setprecision(3);
+		out << "steps         " << lateness.count() << " of " << BENCH_STEP_LENGTH * 1000.0 << " ms" << std::endl;
+		out << "budget        " << budget << " ms at p99" << std::endl;
+		out << std::endl;
+		StageStats::header(out);
+		lateness.print(out, "due to emit");
+		out << std::endl;
+		out << "p99 " << p99 << " ms, " << (p99 <= budget ? "ok" : "FAILED") << std::endl;
+		return p99 <= budget ? 0 : 1;
+	}
+
+	// argv[1] is --bench
+	inline int benchMain(int argc, char* argv[]) {
+		std::string name = argc > 2 ? argv[2] : "";
+		if(name == "queue") {
+			int producers = argc > 3 ? atoi(argv[3]) : 4;
+			long count = argc > 4 ? atol(argv[4]) : 100000;
+			return benchQueue(std::max(producers, 1), std::max(count, 1L));
+		}
+		if(name == "link") {
+			int tangibles = argc > 3 ? atoi(argv[3]) : 40;
+			long frames = argc > 4 ? atol(argv[4]) : 10000;
+			return benchLink(std::max(tangibles, 1), std::max(frames, 1L));
+		}
+		if(name == "stroke") {
+			long count = argc > 3 ? atol(argv[3]) : 200;
+			return benchStroke(std::max(count, 1L));
+		}
+		if(name == "scheduler") {
+			long steps = argc > 3 ? atol(argv[3]) : 500;
+			double budget = argc > 4 ? atof(argv[4]) : BENCH_SCHEDULER_BUDGET;
+			return benchScheduler(std::max(steps, 1L), budget);
+		}
+		std::cerr << "usage: " << argv[0] << " --bench queue [producers] [per producer]" << std::endl;
+		std::cerr << "       " << argv[0] << " --bench link [tangibles] [frames]" << std::endl;
+		std::cerr << "       " << argv[0] << " --bench stroke [strokes per length]" << std::endl;
+		std::cerr << "       " << argv[0] << " --bench scheduler [steps] [budget ms]" << std::endl;
+		return 1;
+	}
+
+}
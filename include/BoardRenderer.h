@@ -0,0 +1,290 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include "cinder/gl/gl.h"
+#include "cinder/gl/GlslProg.h"
+#include "Tangible.h"
+
+#define BOARD_CIRCLE_SEGMENTS 32
+#define BOARD_TWO_PI 6.28318531f
+
+namespace SecondStudy {
+
+	// Draws all the note boards in a handful of instanced draw calls, whatever the number
+	// of tangibles. Everything a board is made of (the disc, the cells, the icons, the
+	// cursor and the ring around playing boards) sits in one static vertex buffer, in the
+	// board's unscaled local frame. Each tangible is one instance: where it is, its angle
+	// and scale, its notes as bit masks, its playhead and whether it's playing. The vertex
+	// shader places the geometry and picks the colours from that.
+	// Needs ARB_draw_instanced and ARB_instanced_arrays.
+	class BoardRenderer {
+	public:
+		struct Instance {
+			float x, y, angle, scale;
+			float lowMask; // columns 0 to 3, 5 bits each
+			float highMask; // columns 4 to 7
+			float playhead; // -1 when it isn't playing
+			float playing; // 1 if the ring is drawn
+		};
+
+	private:
+		// Colour classes, see the shader
+		enum { DISC, CELL, STROKE, RING };
+
+		struct Vertex {
+			float x, y;
+			float colour;
+			float column, pitch; // of a cell, -1 for anything else
+			float cursor; // width the vertex moves by for each step of the playhead, 0 if it isn't the cursor
+		};
+
+		struct Range {
+			GLint first;
+			GLsizei count;
+		};
+
+		gl::GlslProg _shader;
+		GLuint _geometry;
+		GLuint _instances[2];
+		std::vector<Instance> _closed;
+		std::vector<Instance> _open;
+
+		Range _closedFill, _closedLines;
+		Range _openFill, _openLines, _openThickLines;
+
+		GLint _aPosition, _aInfo, _aCursor, _iTransform, _iState;
+		bool _ready;
+
+		static Vertex _vertex(Vec2f p, int colour, int column = -1, int pitch = -1, float cursor = 0.0f) {
+			Vertex v = { p.x, p.y, (float)colour, (float)column, (float)pitch, cursor };
+			return v;
+		}
+
+		static void _quad(std::vector<Vertex>& v, const Rectf& r, int colour, int column = -1, int pitch = -1, float cursor = 0.0f) {
+			v.push_back(_vertex(r.getUpperLeft(), colour, column, pitch, cursor));
+			v.push_back(_vertex(r.getUpperRight(), colour, column, pitch, cursor));
+			v.push_back(_vertex(r.getLowerRight(), colour, column, pitch, cursor));
+			v.push_back(_vertex(r.getUpperLeft(), colour, column, pitch, cursor));
+			v.push_back(_vertex(r.getLowerRight(), colour, column, pitch, cursor));
+			v.push_back(_vertex(r.getLowerLeft(), colour, column, pitch, cursor));
+		}
+
+		static void _outline(std::vector<Vertex>& v, const Rectf& r, int colour) {
+			Vec2f c[4] = { r.getUpperLeft(), r.getUpperRight(), r.getLowerRight(), r.getLowerLeft() };
+			for(int i = 0; i < 4; i++) {
+				v.push_back(_vertex(c[i], colour));
+				v.push_back(_vertex(c[(i + 1) % 4], colour));
+			}
+		}
+
+		static void _disc(std::vector<Vertex>& v, float radius, int colour) {
+			for(int i = 0; i < BOARD_CIRCLE_SEGMENTS; i++) {
+				float a = BOARD_TWO_PI * i / BOARD_CIRCLE_SEGMENTS;
+				float b = BOARD_TWO_PI * (i + 1) / BOARD_CIRCLE_SEGMENTS;
+				v.push_back(_vertex(Vec2f(0.0f, 0.0f), colour));
+				v.push_back(_vertex(Vec2f(cos(a), sin(a)) * radius, colour));
+				v.push_back(_vertex(Vec2f(cos(b), sin(b)) * radius, colour));
+			}
+		}
+
+		static void _circle(std::vector<Vertex>& v, float radius, int colour) {
+			for(int i = 0; i < BOARD_CIRCLE_SEGMENTS; i++) {
+				float a = BOARD_TWO_PI * i / BOARD_CIRCLE_SEGMENTS;
+				float b = BOARD_TWO_PI * (i + 1) / BOARD_CIRCLE_SEGMENTS;
+				v.push_back(_vertex(Vec2f(cos(a), sin(a)) * radius, colour));
+				v.push_back(_vertex(Vec2f(cos(b), sin(b)) * radius, colour));
+			}
+		}
+
+		static void _cells(std::vector<Vertex>& v, const Rectf& board, int columns, int pitches, bool outline) {
+			Vec2f size(board.getSize() / Vec2f((float)columns, (float)pitches));
+			for(int c = 0; c < columns; c++) {
+				for(int p = 0; p < pitches; p++) {
+					Rectf r(Rectf(Vec2f(0.0f, 0.0f), size) + size * Vec2f((float)c, (float)p) + board.getUpperLeft());
+					if(outline) {
+						_outline(v, r, STROKE);
+					} else {
+						_quad(v, r, CELL, c, p);
+					}
+				}
+			}
+		}
+
+		static Range _range(std::vector<Vertex>& all, const std::vector<Vertex>& part) {
+			Range r = { (GLint)all.size(), (GLsizei)part.size() };
+			all.insert(all.end(), part.begin(), part.end());
+			return r;
+		}
+
+		void _draw(GLuint buffer, const std::vector<Instance>& instances, GLenum mode, const Range& range) {
+			if(instances.empty() || range.count == 0) {
+				return;
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, _geometry);
+			glVertexAttribPointer(_aPosition, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)offsetof(Vertex, x));
+			glVertexAttribPointer(_aInfo, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)offsetof(Vertex, colour));
+			glVertexAttribPointer(_aCursor, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)offsetof(Vertex, cursor));
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+			glVertexAttribPointer(_iTransform, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (const GLvoid*)offsetof(Instance, x));
+			glVertexAttribPointer(_iState, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (const GLvoid*)offsetof(Instance, lowMask));
+			glDrawArraysInstancedARB(mode, range.first, range.count, (GLsizei)instances.size());
+		}
+
+	public:
+		BoardRenderer() : _geometry(0), _ready(false) {
+			_instances[0] = _instances[1] = 0;
+		}
+
+		~BoardRenderer() {
+			if(_geometry != 0) {
+				glDeleteBuffers(1, &_geometry);
+				glDeleteBuffers(2, _instances);
+			}
+		}
+
+		// Builds the geometry from the layout of a board. Needs a GL context.
+		// Returns false if instancing isn't available or the shader doesn't build.
+		bool setup(Tangible& layout) {
+			if(!GLEE_ARB_draw_instanced || !GLEE_ARB_instanced_arrays) {
+				return false;
+			}
+
+			try {
+				_shader = gl::GlslProg(
+					"#version 120\n"
+					"attribute vec2 aPosition;\n"
+					"attribute vec3 aInfo;\n" // colour class, column, pitch
+					"attribute float aCursor;\n"
+					"attribute vec4 iTransform;\n" // x, y, angle, scale
+					"attribute vec4 iState;\n" // low mask, high mask, playhead, playing
+					"varying vec4 vColour;\n"
+					"void main() {\n"
+					"	vec2 p = aPosition + vec2(aCursor * max(iState.z, 0.0), 0.0);\n"
+					"	float c = cos(iTransform.z);\n"
+					"	float s = sin(iTransform.z);\n"
+					"	p = vec2(p.x * c - p.y * s, p.x * s + p.y * c) * iTransform.w + iTransform.xy;\n"
+					"	float grey = 0.625;\n"
+					"	if(aInfo.x < 0.5) {\n"
+					"		grey = 0.2;\n"
+					"	} else if(aInfo.x < 1.5) {\n"
+					"		float mask = aInfo.y < 3.5 ? iState.x : iState.y;\n"
+					"		float bit = mod(aInfo.y, 4.0) * 5.0 + aInfo.z;\n"
+					"		grey = mod(floor(mask / exp2(bit)), 2.0) > 0.5 ? 0.5 : 0.25;\n"
+					"	} else if(aInfo.x > 2.5) {\n"
+					"		grey = 1.0;\n"
+					"	}\n"
+					"	vColour = vec4(grey, grey, grey, 1.0);\n"
+					"	gl_Position = gl_ModelViewProjectionMatrix * vec4(p, 0.0, 1.0);\n"
+					"	if(aInfo.x > 2.5 && iState.w < 0.5) {\n"
+					"		gl_Position = vec4(0.0, 0.0, 2.0, 1.0);\n" // no ring, clipped away
+					"	}\n"
+					"}\n",
+					"#version 120\n"
+					"varying vec4 vColour;\n"
+					"void main() {\n"
+					"	gl_FragColor = vColour;\n"
+					"}\n");
+			} catch(gl::GlslProgCompileExc&) {
+				return false;
+			}
+			GLuint program = _shader.getHandle();
+			_aPosition = glGetAttribLocation(program, "aPosition");
+			_aInfo = glGetAttribLocation(program, "aInfo");
+			_aCursor = glGetAttribLocation(program, "aCursor");
+			_iTransform = glGetAttribLocation(program, "iTransform");
+			_iState = glGetAttribLocation(program, "iState");
+
+			int columns = layout.size().first;
+			int pitches = layout.size().second;
+			std::vector<Vertex> all, v;
+
+			_disc(v, 50.0f, DISC);
+			_cells(v, layout.icon, columns, pitches, false);
+			_closedFill = _range(all, v);
+			v.clear();
+
+			_circle(v, 60.0f, RING);
+			_closedLines = _range(all, v);
+			v.clear();
+
+			_disc(v, 50.0f, DISC);
+			_cells(v, layout.board, columns, pitches, false);
+			Rectf play(layout.playIcon);
+			v.push_back(_vertex(play.getUpperLeft() + Vec2f(5.0f, 5.0f), STROKE));
+			v.push_back(_vertex(play.getLowerLeft() + Vec2f(5.0f, -5.0f), STROKE));
+			v.push_back(_vertex(play.getCenter() + Vec2f(5.0f, 0.0f), STROKE));
+			_quad(v, layout.cursor, STROKE, -1, -1, layout.cursor.getWidth());
+			_openFill = _range(all, v);
+			v.clear();
+
+			_cells(v, layout.board, columns, pitches, true);
+			_outline(v, layout.closeIcon, STROKE);
+			_outline(v, layout.playIcon, STROKE);
+			_circle(v, 60.0f, RING);
+			_openLines = _range(all, v);
+			v.clear();
+
+			Rectf close(layout.closeIcon);
+			v.push_back(_vertex(close.getUpperLeft() + Vec2f(5.0f, 5.0f), STROKE));
+			v.push_back(_vertex(close.getLowerRight() + Vec2f(-5.0f, -5.0f), STROKE));
+			v.push_back(_vertex(close.getUpperRight() + Vec2f(-5.0f, 5.0f), STROKE));
+			v.push_back(_vertex(close.getLowerLeft() + Vec2f(5.0f, -5.0f), STROKE));
+			_openThickLines = _range(all, v);
+
+			glGenBuffers(1, &_geometry);
+			glBindBuffer(GL_ARRAY_BUFFER, _geometry);
+			glBufferData(GL_ARRAY_BUFFER, all.size() * sizeof(Vertex), &all[0], GL_STATIC_DRAW);
+			glGenBuffers(2, _instances);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			_ready = true;
+			return true;
+		}
+
+		bool isReady() const { return _ready; }
+
+		// Instances are collected between begin() and draw(), at most once per tangible.
+		void begin() {
+			_closed.clear();
+			_open.clear();
+		}
+
+		void add(const Instance& i, bool isOn) {
+			(isOn ? _open : _closed).push_back(i);
+		}
+
+		void draw(float scale) {
+			if(!_ready) {
+				return;
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, _instances[0]);
+			glBufferData(GL_ARRAY_BUFFER, _closed.size() * sizeof(Instance), _closed.empty() ? nullptr : &_closed[0], GL_STREAM_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, _instances[1]);
+			glBufferData(GL_ARRAY_BUFFER, _open.size() * sizeof(Instance), _open.empty() ? nullptr : &_open[0], GL_STREAM_DRAW);
+
+			_shader.bind();
+			GLint attributes[5] = { _aPosition, _aInfo, _aCursor, _iTransform, _iState };
+			for(int i = 0; i < 5; i++) {
+				glEnableVertexAttribArray(attributes[i]);
+				glVertexAttribDivisorARB(attributes[i], i < 3 ? 0 : 1);
+			}
+
+			_draw(_instances[0], _closed, GL_TRIANGLES, _closedFill);
+			_draw(_instances[0], _closed, GL_LINES, _closedLines);
+			_draw(_instances[1], _open, GL_TRIANGLES, _openFill);
+			_draw(_instances[1], _open, GL_LINES, _openLines);
+			glLineWidth(2.0f * scale);
+			_draw(_instances[1], _open, GL_LINES, _openThickLines);
+			glLineWidth(1.0f * scale);
+
+			for(int i = 0; i < 5; i++) {
+				glVertexAttribDivisorARB(attributes[i], 0);
+				glDisableVertexAttribArray(attributes[i]);
+			}
+			_shader.unbind();
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+	};
+
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+
+#include "osc/OscReceivedElements.h"
+#include "osc/OscException.h"
+#include "ip/UdpSocket.h"
+#include "ip/PacketListener.h"
+#include "NoteSender.h"
+
+#define CHECK_SENDER_PORT 57130 // well away from the 3000 the app sends to
+#define CHECK_SENDER_TIMEOUT 2.0 // seconds to wait for packets before giving up
+#define CHECK_TIMETAG_TOLERANCE 0.002 // seconds
+
+namespace SecondStudy {
+
+	// Self-checks of the parts of the app that talk to the outside world, run by the
+	// headless build with --check name. Each prints what it found and returns non-zero
+	// if anything was off.
+
+	// Keeps every packet that comes in on a UDP port, on a thread of its own.
+	class LoopbackReceiver : public PacketListener {
+		UdpListeningReceiveSocket _socket;
+		std::thread _thread;
+		std::mutex _mutex;
+		std::condition_variable _cv;
+		std::vector<std::string> _packets;
+
+	public:
+		LoopbackReceiver(int port) : _socket(IpEndpointName(IpEndpointName::ANY_ADDRESS, port), this) {
+			_thread = std::thread([this] { _socket.Run(); });
+		}
+
+		~LoopbackReceiver() {
+			_socket.AsynchronousBreak();
+			_thread.join();
+		}
+
+		virtual void ProcessPacket(const char* data, int size, const IpEndpointName& remoteEndpoint) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_packets.push_back(std::string(data, size));
+			_cv.notify_all();
+		}
+
+		// Waits until done(what came in so far) or the timeout, and returns what came in.
+		std::vector<std::string> wait(std::function<bool(const std::vector<std::string>&)> done, double timeout) {
+			std::unique_lock<std::mutex> lock(_mutex);
+			_cv.wait_for(lock, std::chrono::duration<double>(timeout), [&] { return done(_packets); });
+			return _packets;
+		}
+	};
+
+	struct ReceivedNote {
+		int note;
+		double timetag; // NTP, seconds since 1900
+		size_t packet;
+	};
+
+	// The notes in packets sent by a NoteSender, in the order they came in. Fails on
+	// anything but bundles of /playnote messages with one int32 each.
+	inline bool parseNotes(const std::vector<std::string>& packets, std::vector<ReceivedNote>& notes, std::string& error) {
+		notes.clear();
+		try {
+			for(size_t i = 0; i < packets.size(); i++) {
+				::osc::ReceivedPacket packet(packets[i].data(), (::osc::int32)packets[i].size());
+				if(!packet.IsBundle()) {
+					error = "got a packet that isn't a bundle";
+					return false;
+				}
+				::osc::ReceivedBundle bundle(packet);
+				::osc::uint64 tag = bundle.TimeTag();
+				double timetag = (tag >> 32) + (tag & 0xffffffff) / 4294967296.0;
+				for(auto e = bundle.ElementsBegin(); e != bundle.ElementsEnd(); ++e) {
+					if(!e->IsMessage()) {
+						error = "got a nested bundle";
+						return false;
+					}
+					::osc::ReceivedMessage message(*e);
+					if(std::string(message.AddressPattern()) != "/playnote" || message.ArgumentCount() != 1 || !message.ArgumentsBegin()->IsInt32()) {
+						error = std::string("got something other than /playnote int32: ") + message.AddressPattern();
+						return false;
+					}
+					ReceivedNote n = { (int)message.ArgumentsBegin()->AsInt32(), timetag, i };
+					notes.push_back(n);
+				}
+			}
+		} catch(::osc::Exception& e) {
+			error = std::string("malformed packet: ") + e.what();
+			return false;
+		}
+		return true;
+	}
+
+	// The NTP time a NoteSender should stamp on notes due at when, in seconds since 1900.
+	inline double expectedTimetag(Scheduler::Clock::time_point when) {
+		using namespace std::chrono;
+		system_clock::time_point wall = system_clock::now() + duration_cast<system_clock::duration>(when - Scheduler::Clock::now());
+		return duration<double>(wall.time_since_epoch()).count() + 2208988800.0;
+	}
+
+	// Sends steps through a NoteSender to a receiver on this machine and checks what
+	// arrives: the notes of a step in the order they were given, in one bundle unless
+	// there are too many for one packet, and every bundle timetagged with when its step
+	// is due, to within CHECK_TIMETAG_TOLERANCE.
+	//   --check sender [port]
+	inline int checkSender(int port) {
+		struct Step {
+			std::vector<int> notes;
+			double timetag;
+		};
+		std::vector<Step> steps(2);
+		steps[0].notes.push_back(0);
+		steps[0].notes.push_back(3);
+		steps[0].notes.push_back(39);
+		// Far too many for one packet, so it's split over several bundles
+		for(int n = 0; n < 500; n++) {
+			steps[1].notes.push_back(n);
+		}
+		size_t total = steps[0].notes.size() + steps[1].notes.size();
+
+		LoopbackReceiver receiver(port);
+		NoteSender sender("127.0.0.1", port);
+		for(size_t i = 0; i < steps.size(); i++) {
+			Scheduler::Clock::time_point when = Scheduler::Clock::now() + std::chrono::milliseconds(250 * (i + 1));
+			steps[i].timetag = expectedTimetag(when);
+			sender.send(when, steps[i].notes);
+		}
+		std::vector<ReceivedNote> notes;
+		std::string error;
+		std::vector<std::string> received = receiver.wait([&](const std::vector<std::string>& packets) {
+			return !parseNotes(packets, notes, error) || notes.size() >= total;
+		}, CHECK_SENDER_TIMEOUT);
+
+		bool ok = parseNotes(received, notes, error);
+		if(!ok) {
+			std::cout << "sender: " << error << std::endl;
+		}
+		size_t n = 0;
+		for(size_t i = 0; ok && i < steps.size(); i++) {
+			size_t first = n;
+			for(int note : steps[i].notes) {
+				if(n >= notes.size()) {
+					std::cout << "sender: only " << notes.size() << " of " << total << " notes arrived" << std::endl;
+					ok = false;
+				} else if(notes[n].note != note) {
+					std::cout << "sender: note " << n << " is " << notes[n].note << ", expected " << note << std::endl;
+					ok = false;
+				} else if(std::abs(notes[n].timetag - steps[i].timetag) > CHECK_TIMETAG_TOLERANCE) {
+					std::cout << "sender: timetag of note " << n << " off by " << (notes[n].timetag - steps[i].timetag) * 1000.0 << " ms" << std::endl;
+					ok = false;
+				} else if(i == 0 && notes[n].packet != notes[first].packet) {
+					std::cout << "sender: a step of " << steps[i].notes.size() << " notes was split" << std::endl;
+					ok = false;
+				}
+				if(!ok) {
+					break;
+				}
+				n++;
+			}
+		}
+		if(ok && notes.size() > total) {
+			std::cout << "sender: " << notes.size() - total << " notes too many" << std::endl;
+			ok = false;
+		}
+		std::cout << "sender: " << received.size() << " packets, " << notes.size() << " notes, " << (ok ? "ok" : "FAILED") << std::endl;
+		return ok ? 0 : 1;
+	}
+
+	// argv[1] is --check
+	inline int checkMain(int argc, char* argv[]) {
+		std::string name = argc > 2 ? argv[2] : "";
+		if(name == "sender") {
+			return checkSender(argc > 3 ? atoi(argv[3]) : CHECK_SENDER_PORT);
+		}
+		std::cerr << "usage: " << argv[0] << " --check sender [port]" << std::endl;
+		return 1;
+	}
+
+}
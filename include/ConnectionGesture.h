@@ -0,0 +1,17 @@
+#pragma once
+
+namespace SecondStudy {
+	
+	// Payload of a Gesture::CONNECTION, a stroke that was known to link from to to
+	// before the finger even came up.
+	class ConnectionGesture {
+	public:
+		int from;
+		int to;
+		
+		ConnectionGesture() : from(-1), to(-1) { }
+		ConnectionGesture(int f, int t) : from(f), to(t) {
+			
+		}
+	};
+}
\ No newline at end of file
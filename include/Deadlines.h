@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <functional>
+
+namespace SecondStudy {
+
+	// Min-heap of things that are due at some time, in seconds (see elapsedSeconds()),
+	// so that whoever polls it only ever looks at what is due. Entries can't be taken
+	// back: whoever pops one checks it still applies, and arms it again if need be.
+	template<typename T>
+	class Deadlines {
+		typedef std::pair<double, T> Entry;
+
+		std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> _heap;
+		std::mutex _mutex;
+
+	public:
+		void arm(double when, const T& what) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_heap.push(Entry(when, what));
+		}
+
+		// Takes out one entry due by now. Returns false if there is none.
+		bool pop(double now, T& what) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			if(_heap.empty() || _heap.top().first > now) {
+				return false;
+			}
+			what = _heap.top().second;
+			_heap.pop();
+			return true;
+		}
+
+		size_t size() {
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _heap.size();
+		}
+	};
+
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <ostream>
+#include <cstdint>
+#include "cinder/gl/gl.h"
+#include "BoardRenderer.h"
+#include "StageStats.h"
+#include "Tangible.h"
+
+#define DRAW_BENCH_BOARDS 40
+#define DRAW_BENCH_FRAMES 600
+#define DRAW_BENCH_WARMUP 30 // frames drawn before timing each way, while drivers settle
+
+namespace SecondStudy {
+
+	// A fixed scene of boards, drawn by the windowed build instead of the table with
+	//   SecondStudy --bench draw [boards] [frames]
+	// It draws frames frames through BoardRenderer, then as many again one board at a time
+	// the way draw() did before it, and times each up to glFinish(), so what the GPU does
+	// counts too. The scene comes from a fixed seed: the same boards in the same places
+	// every run, half of them open, a third of them playing.
+	class DrawBench {
+		Tangible _layout;
+		std::vector<BoardRenderer::Instance> _instances;
+		std::vector<bool> _isOn;
+		long _frames;
+		long _frame;
+		StageStats _instanced;
+		StageStats _oneByOne;
+
+		static bool _note(const BoardRenderer::Instance& i, int column, int pitch) {
+			uint32_t mask = (uint32_t)(column < 4 ? i.lowMask : i.highMask);
+			return (mask >> ((column % 4) * 5 + pitch) & 1) != 0;
+		}
+
+		// One board the way draw() had it before BoardRenderer: a GL call or more for every
+		// shape, and the icons redrawn for every cell.
+		void _drawOne(const BoardRenderer::Instance& i, bool isOn) {
+			float scale = i.scale;
+			ci::gl::pushModelView();
+			ci::Matrix44f transform;
+			transform.translate(ci::Vec3f(i.x, i.y, 0.0f));
+			transform.rotate(ci::Vec3f(0.0f, 0.0f, i.angle));
+			ci::gl::multModelView(transform);
+
+			ci::gl::color(0.2f, 0.2f, 0.2f, 1.0f);
+			ci::gl::drawSolidCircle(ci::Vec2f(0,0), 50.0f*scale);
+			ci::gl::color(1,1,1,1);
+			if(i.playing > 0.5f) {
+				ci::gl::drawStrokedCircle(ci::Vec2f(0,0), 60.0f*scale);
+			}
+
+			ci::Rectf board = isOn ? _layout.board : _layout.icon;
+			std::pair<int, int> size = _layout.size();
+			ci::ColorAf off(0.25f, 0.25f, 0.25f, 1.0f);
+			ci::ColorAf on(0.5f, 0.5f, 0.5f, 1.0f);
+			for(int row = 0; row < size.first; row++) {
+				for(int col = 0; col < size.second; col++) {
+					ci::gl::color(_note(i, row, col) ? on : off);
+					ci::Vec2f noteRectSize(board.getSize() / ci::Vec2f((float)size.first, (float)size.second));
+					ci::Rectf noteRect(ci::Vec2f(0.0f, 0.0f), noteRectSize);
+					ci::gl::drawSolidRect((noteRect + noteRectSize*ci::Vec2f((float)row, (float)col) + board.getUpperLeft()) * scale);
+					if(isOn) {
+						ci::gl::color(on * 1.25f);
+						ci::gl::drawStrokedRect((noteRect + noteRectSize*ci::Vec2f((float)row, (float)col) + board.getUpperLeft()) * scale);
+
+						ci::Rectf closeIcon = _layout.closeIcon * scale;
+						ci::gl::drawStrokedRect(closeIcon);
+						ci::gl::lineWidth(2.0f * scale);
+						ci::gl::drawLine(closeIcon.getUpperLeft() + ci::Vec2f(5.0f, 5.0f)*scale, closeIcon.getLowerRight() + ci::Vec2f(-5.0f, -5.0f)*scale);
+						ci::gl::drawLine(closeIcon.getUpperRight() + ci::Vec2f(-5.0f, 5.0f)*scale, closeIcon.getLowerLeft() + ci::Vec2f(5.0f, -5.0f)*scale);
+						ci::gl::lineWidth(1.0f * scale);
+
+						ci::Rectf playIcon = _layout.playIcon * scale;
+						ci::gl::drawStrokedRect(playIcon);
+						ci::gl::drawSolidTriangle(playIcon.getUpperLeft() + ci::Vec2f(5.0f, 5.0f)*scale, playIcon.getLowerLeft() + ci::Vec2f(5.0f, -5.0f)*scale, playIcon.getCenter() + ci::Vec2f(5.0f, 0.0f)*scale);
+
+						ci::Rectf cursor = (_layout.cursor + ci::Vec2f(_layout.cursor.getWidth() * std::max((int)i.playhead, 0), 0.0f)) * scale;
+						ci::gl::drawSolidRect(cursor);
+					}
+				}
+			}
+			ci::gl::popModelView();
+		}
+
+	public:
+		DrawBench(int boards, long frames, ci::Vec2f window, float scale) : _frames(frames), _frame(0) {
+			std::mt19937 random(1);
+			std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+			std::uniform_int_distribution<uint32_t> notes(0, (1 << 20) - 1);
+			for(int n = 0; n < boards; n++) {
+				BoardRenderer::Instance i;
+				i.x = unit(random) * window.x;
+				i.y = unit(random) * window.y;
+				i.angle = unit(random) * BOARD_TWO_PI;
+				i.scale = scale;
+				i.lowMask = (float)notes(random);
+				i.highMask = (float)notes(random);
+				i.playing = n % 3 == 0 ? 1.0f : 0.0f;
+				i.playhead = i.playing > 0.5f ? (float)(n % 8) : -1.0f;
+				_instances.push_back(i);
+				_isOn.push_back(n % 2 == 0);
+			}
+		}
+
+		// Draws the next frame, one way or the other. False once both have been timed.
+		bool frame(BoardRenderer& renderer) {
+			long round = DRAW_BENCH_WARMUP + _frames;
+			if(_frame >= 2 * round) {
+				return false;
+			}
+			bool instanced = _frame < round;
+			bool timed = _frame % round >= DRAW_BENCH_WARMUP;
+			_frame++;
+
+			StageStats& stats = instanced ? _instanced : _oneByOne;
+			StageStats::Clock::time_point start = StageStats::Clock::now();
+			ci::gl::clear(ci::Color(0, 0, 0));
+			if(instanced) {
+				renderer.begin();
+				for(size_t n = 0; n < _instances.size(); n++) {
+					renderer.add(_instances[n], _isOn[n]);
+				}
+				renderer.draw(_instances.empty() ? 1.0f : _instances[0].scale);
+			} else {
+				for(size_t n = 0; n < _instances.size(); n++) {
+					_drawOne(_instances[n], _isOn[n]);
+				}
+			}
+			glFinish();
+			if(timed) {
+				stats.add(StageStats::Clock::now() - start);
+			}
+			return true;
+		}
+
+		void print(std::ostream& out) const {
+			out << _instances.size() << " boards, " << _frames << " frames each way" << std::endl;
+			StageStats::header(out);
+			_instanced.print(out, "instanced");
+			_oneByOne.print(out, "one by one");
+		}
+	};
+
+}
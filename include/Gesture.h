@@ -1,11 +1,35 @@
 #pragma once
 
+#include <chrono>
+#include "TapGesture.h"
+#include "StrokeGesture.h"
+#include "ConnectionGesture.h"
+
 namespace SecondStudy {
 
+// A recognised gesture, carried by value in the slots of the GestureQueue so that
+// handing one over allocates nothing. type says which payload is meaningful; a new
+// kind of gesture gets a type and a payload of its own.
 class Gesture {
 	
 public:
-	virtual ~Gesture() { }
+	enum Type {
+		NONE,
+		TAP,
+		STROKE,
+		CONNECTION
+	};
+
+	Type type;
+	TapGesture tap;
+	StrokeGesture stroke;
+	ConnectionGesture connection;
+	std::chrono::steady_clock::time_point classified; // when the trace turned into this gesture
+
+	Gesture() : type(NONE) { }
+	Gesture(const TapGesture& t) : type(TAP), tap(t), classified(std::chrono::steady_clock::now()) { }
+	Gesture(const StrokeGesture& s) : type(STROKE), stroke(s), classified(std::chrono::steady_clock::now()) { }
+	Gesture(const ConnectionGesture& c) : type(CONNECTION), connection(c), classified(std::chrono::steady_clock::now()) { }
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace SecondStudy {
+
+	// Bounded multi-producer, single-consumer ring buffer.
+	// Producers never block: push() fails if the ring is full. The consumer
+	// sleeps on a condition variable when the ring is empty and is woken up
+	// by the next push(), so an idle table costs no CPU at all.
+	template<typename T, size_t N>
+	class GestureQueue {
+		struct Slot {
+			std::atomic<size_t> sequence;
+			T value;
+		};
+
+		Slot _slots[N];
+		std::atomic<size_t> _head; // next slot to be written
+		std::atomic<size_t> _tail; // next slot to be read
+
+		std::mutex _mutex;
+		std::condition_variable _cv;
+		std::atomic<bool> _waiting;
+		std::atomic<bool> _closed;
+
+		bool _tryPop(T& value) {
+			size_t pos = _tail.load(std::memory_order_relaxed);
+			Slot& s = _slots[pos % N];
+			size_t seq = s.sequence.load();
+			if(seq != pos + 1) {
+				return false; // empty
+			}
+			value = std::move(s.value);
+			s.value = T();
+			_tail.store(pos + 1, std::memory_order_relaxed);
+			s.sequence.store(pos + N, std::memory_order_release);
+			return true;
+		}
+
+	public:
+		GestureQueue() : _head(0), _tail(0), _waiting(false), _closed(false) {
+			for(size_t i = 0; i < N; i++) {
+				_slots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		bool push(const T& value) {
+			size_t pos = _head.load(std::memory_order_relaxed);
+			Slot* s;
+			while(true) {
+				s = &_slots[pos % N];
+				size_t seq = s->sequence.load(std::memory_order_acquire);
+				if(seq == pos) {
+					if(_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				} else if(seq < pos) {
+					return false; // full
+				} else {
+					pos = _head.load(std::memory_order_relaxed);
+				}
+			}
+			s->value = value;
+			s->sequence.store(pos + 1);
+
+			// Only pay for the mutex if the consumer is actually asleep.
+			if(_waiting.load()) {
+				std::lock_guard<std::mutex> lock(_mutex);
+				_cv.notify_one();
+			}
+			return true;
+		}
+
+		// Blocks until an element is available. Returns false once the queue
+		// has been closed and drained.
+		bool waitPop(T& value) {
+			while(true) {
+				if(_tryPop(value)) {
+					return true;
+				}
+				std::unique_lock<std::mutex> lock(_mutex);
+				_waiting.store(true);
+				// Re-check now that producers can see we're about to sleep.
+				if(_tryPop(value)) {
+					_waiting.store(false);
+					return true;
+				}
+				if(_closed.load()) {
+					_waiting.store(false);
+					return false;
+				}
+				_cv.wait(lock);
+				_waiting.store(false);
+			}
+		}
+
+		bool tryPop(T& value) { return _tryPop(value); }
+
+		void close() {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_closed.store(true);
+			_cv.notify_all();
+		}
+
+		// Roughly how many elements are waiting, from any thread. _tail never gets ahead
+		// of _head, so loading _tail first means the _head loaded after it can't be behind
+		// it. The clamp is only there in case that ever changes.
+		size_t size() const {
+			size_t tail = _tail.load();
+			size_t head = _head.load();
+			return head > tail ? head - tail : 0;
+		}
+	};
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <iostream>
+#include "cinder/Vector.h"
+#include "SessionTime.h"
+
+#define HEADLESS_WINDOW_WIDTH 640
+#define HEADLESS_WINDOW_HEIGHT 480
+
+namespace SecondStudy {
+
+	// Stands in for AppNative when there is no window and no GL context: just the bits
+	// of the app interface the table logic uses. The window is a fixed 640x480, which is
+	// what all the board sizes are defined against, and console() goes nowhere unless
+	// asked to, so the prints in the hot paths don't end up in the measurements.
+	class HeadlessApp {
+		std::ostream _quiet;
+		bool _verbose;
+
+	public:
+		HeadlessApp() : _quiet(nullptr), _verbose(false) { }
+		virtual ~HeadlessApp() { }
+
+		void setVerbose(bool verbose) { _verbose = verbose; }
+		std::ostream& console() { return _verbose ? std::cerr : _quiet; }
+
+		double getElapsedSeconds() const { return elapsedSeconds(); }
+
+		int getWindowWidth() const { return HEADLESS_WINDOW_WIDTH; }
+		int getWindowHeight() const { return HEADLESS_WINDOW_HEIGHT; }
+		ci::Vec2i getWindowSize() const { return ci::Vec2i(HEADLESS_WINDOW_WIDTH, HEADLESS_WINDOW_HEIGHT); }
+
+		void setFrameRate(float fps) { }
+		void setWindowSize(int width, int height) { }
+	};
+
+}
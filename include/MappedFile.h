@@ -0,0 +1,158 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace SecondStudy {
+
+	// A whole file mapped into memory, either created read-write at a given size or
+	// opened read-only as it is.
+	class MappedFile {
+		char* _data;
+		size_t _size;
+#if defined(_WIN32)
+		HANDLE _file;
+		HANDLE _mapping;
+#else
+		int _fd;
+#endif
+
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
+
+	public:
+#if defined(_WIN32)
+		MappedFile() : _data(nullptr), _size(0), _file(INVALID_HANDLE_VALUE), _mapping(NULL) { }
+#else
+		MappedFile() : _data(nullptr), _size(0), _fd(-1) { }
+#endif
+
+		~MappedFile() { close(); }
+
+		// Creates path, size bytes long and zero filled. Fails if path exists already,
+		// nothing is ever overwritten.
+		bool create(const std::string& path, size_t size) {
+			close();
+#if defined(_WIN32)
+			_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+			if(_file == INVALID_HANDLE_VALUE) {
+				return false;
+			}
+			_mapping = CreateFileMappingA(_file, NULL, PAGE_READWRITE, 0, (DWORD)size, NULL);
+			if(_mapping == NULL) {
+				close();
+				return false;
+			}
+			_data = (char*)MapViewOfFile(_mapping, FILE_MAP_WRITE, 0, 0, size);
+#else
+			_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+			if(_fd == -1) {
+				return false;
+			}
+			if(ftruncate(_fd, size) != 0) {
+				close();
+				return false;
+			}
+			void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+			_data = p == MAP_FAILED ? nullptr : (char*)p;
+#endif
+			if(_data == nullptr) {
+				close();
+				return false;
+			}
+			_size = size;
+			return true;
+		}
+
+		bool open(const std::string& path) {
+			close();
+#if defined(_WIN32)
+			_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if(_file == INVALID_HANDLE_VALUE) {
+				return false;
+			}
+			size_t size = GetFileSize(_file, NULL);
+			if(size == 0 || size == INVALID_FILE_SIZE) {
+				close();
+				return false;
+			}
+			_mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if(_mapping == NULL) {
+				close();
+				return false;
+			}
+			_data = (char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+			_fd = ::open(path.c_str(), O_RDONLY);
+			if(_fd == -1) {
+				return false;
+			}
+			struct stat st;
+			if(fstat(_fd, &st) != 0 || st.st_size == 0) {
+				close();
+				return false;
+			}
+			size_t size = st.st_size;
+			void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, _fd, 0);
+			_data = p == MAP_FAILED ? nullptr : (char*)p;
+#endif
+			if(_data == nullptr) {
+				close();
+				return false;
+			}
+			_size = size;
+			return true;
+		}
+
+		// Unmaps and closes the file. If truncate is given, a file created by create() is cut down to that many bytes.
+		void close(size_t truncate = 0) {
+#if defined(_WIN32)
+			if(_data != nullptr) {
+				UnmapViewOfFile(_data);
+			}
+			if(_mapping != NULL) {
+				CloseHandle(_mapping);
+			}
+			if(_file != INVALID_HANDLE_VALUE) {
+				if(truncate > 0 && truncate < _size) {
+					SetFilePointer(_file, (LONG)truncate, NULL, FILE_BEGIN);
+					SetEndOfFile(_file);
+				}
+				CloseHandle(_file);
+			}
+			_mapping = NULL;
+			_file = INVALID_HANDLE_VALUE;
+#else
+			if(_data != nullptr) {
+				munmap(_data, _size);
+			}
+			if(_fd != -1) {
+				if(truncate > 0 && truncate < _size) {
+					if(ftruncate(_fd, truncate) != 0) {
+						// Nothing lost, the file is just longer than it needs to be
+					}
+				}
+				::close(_fd);
+			}
+			_fd = -1;
+#endif
+			_data = nullptr;
+			_size = 0;
+		}
+
+		bool isOpen() const { return _data != nullptr; }
+		char* data() { return _data; }
+		const char* data() const { return _data; }
+		size_t size() const { return _size; }
+	};
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace SecondStudy {
+
+	// Grid of notes with one bit mask per column, one bit per pitch.
+	// Each column also keeps the list of MIDI notes it plays, rebuilt only when
+	// that column changes, so playing a column is a plain copy.
+	template<int COLUMNS, int PITCHES>
+	class NoteGrid {
+		static_assert(PITCHES <= 32, "A column is a 32 bit mask");
+
+		uint32_t _masks[COLUMNS];
+		int _pitches[PITCHES]; // MIDI note of each row
+		int _notes[COLUMNS][PITCHES];
+		int _count[COLUMNS];
+
+		void _rebuild(int column) {
+			_count[column] = 0;
+			for(int p = 0; p < PITCHES; p++) {
+				if(_masks[column] & (1u << p)) {
+					_notes[column][_count[column]++] = _pitches[p];
+				}
+			}
+		}
+
+	public:
+		NoteGrid() {
+			for(int c = 0; c < COLUMNS; c++) {
+				_masks[c] = 0;
+				_count[c] = 0;
+			}
+			for(int p = 0; p < PITCHES; p++) {
+				_pitches[p] = 0;
+			}
+		}
+
+		static int columns() { return COLUMNS; }
+		static int pitches() { return PITCHES; }
+
+		void pitch(int p, int midi) {
+			_pitches[p] = midi;
+			for(int c = 0; c < COLUMNS; c++) {
+				_rebuild(c);
+			}
+		}
+
+		bool get(int column, int pitch) const { return (_masks[column] & (1u << pitch)) != 0; }
+		uint32_t mask(int column) const { return _masks[column]; }
+
+		void set(int column, uint32_t mask) {
+			_masks[column] = mask;
+			_rebuild(column);
+		}
+
+		// Only one note per column: turns the note on (and every other one in the column off), or off.
+		void toggle(int column, int pitch) {
+			uint32_t bit = 1u << pitch;
+			set(column, (_masks[column] & bit) ? 0 : bit);
+		}
+
+		void append(int column, std::vector<int>& out) const {
+			out.insert(out.end(), _notes[column], _notes[column] + _count[column]);
+		}
+	};
+
+}
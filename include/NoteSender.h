@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include "osc/OscOutboundPacketStream.h"
+#include "ip/UdpSocket.h"
+#include "Scheduler.h"
+
+#define NOTE_SENDER_BUFFER_SIZE 4096
+
+namespace SecondStudy {
+
+	// Sends all the notes of a step as one OSC bundle, timetagged with when they should sound,
+	// so the receiver can absorb whatever delay there is between here and there.
+	// The packet is built in place in a fixed buffer: nothing is allocated per step.
+	class NoteSender {
+		char _buffer[NOTE_SENDER_BUFFER_SIZE];
+		::osc::OutboundPacketStream _packet;
+		UdpTransmitSocket _socket;
+
+		// NTP time: seconds since 1900 in the upper 32 bits, the fraction in the lower 32.
+		static ::osc::uint64 _timetag(Scheduler::Clock::time_point when) {
+			using namespace std::chrono;
+			system_clock::time_point wall = system_clock::now() + duration_cast<system_clock::duration>(when - Scheduler::Clock::now());
+			double seconds = duration<double>(wall.time_since_epoch()).count() + 2208988800.0; // 1900 to 1970
+			::osc::uint64 whole = (::osc::uint64)seconds;
+			::osc::uint64 fraction = (::osc::uint64)((seconds - whole) * 4294967296.0);
+			return (whole << 32) | fraction;
+		}
+
+	public:
+		NoteSender(const std::string& host, int port) : _packet(_buffer, NOTE_SENDER_BUFFER_SIZE), _socket(IpEndpointName(host.c_str(), port)) { }
+
+		void send(Scheduler::Clock::time_point when, const std::vector<int>& notes) {
+			if(notes.empty()) {
+				return;
+			}
+			::osc::uint64 timetag = _timetag(when);
+			_packet.Clear();
+			_packet << ::osc::BeginBundle(timetag);
+			for(int n : notes) {
+				// One /playnote message is well under 64 bytes, start a new bundle before running out
+				if(_packet.Capacity() - _packet.Size() < 64) {
+					_packet << ::osc::EndBundle;
+					_socket.Send(_packet.Data(), _packet.Size());
+					_packet.Clear();
+					_packet << ::osc::BeginBundle(timetag);
+				}
+				_packet << ::osc::BeginMessage("/playnote") << (::osc::int32)n << ::osc::EndMessage;
+			}
+			_packet << ::osc::EndBundle;
+			_socket.Send(_packet.Data(), _packet.Size());
+		}
+	};
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include "Tangible.h"
+#include "SlotMap.h"
+#include "Snapshot.h"
+
+namespace SecondStudy {
+
+	// Where the visible tangibles were as of one TUIO frame, for the threads other than
+	// the main one. The poses are one flat array, and which fiducial ID is where in it
+	// is an index of its own, shared by every frame until tangibles come or go.
+	class PoseFrame {
+	public:
+		struct Index {
+			std::unordered_map<int, uint32_t> byId;
+			std::vector<int> ids; // of each pose
+		};
+
+	private:
+		std::shared_ptr<const Index> _index;
+		std::vector<Tangible::Pose> _poses;
+
+		friend class PosePublisher;
+
+	public:
+		PoseFrame() : _index(std::make_shared<Index>()) { }
+
+		size_t size() const { return _poses.size(); }
+		int id(size_t i) const { return _index->ids[i]; }
+		const Tangible::Pose& operator[](size_t i) const { return _poses[i]; }
+
+		// nullptr if the tangible isn't visible
+		const Tangible::Pose* find(int id) const {
+			auto it = _index->byId.find(id);
+			return it != _index->byId.end() ? &_poses[it->second] : nullptr;
+		}
+
+		// Of a tangible that is visible, throws std::out_of_range otherwise.
+		const Tangible::Pose& at(int id) const { return _poses[_index->byId.at(id)]; }
+	};
+
+	// Publishes the main thread's poses a frame at a time. Each frame is copied into a
+	// PoseFrame that no reader holds any more, kept from before, so moving tangibles
+	// around allocates nothing; there are only ever as many as are held at once. The
+	// index is only built again when the IDs in the map aren't the ones it has.
+	class PosePublisher {
+		std::vector<std::shared_ptr<PoseFrame>> _frames;
+		std::shared_ptr<const PoseFrame::Index> _index;
+		Snapshot<PoseFrame> _snapshot;
+
+		bool _indexes(const SlotMap<Tangible::Pose>& poses) const {
+			if(_index->ids.size() != poses.size()) {
+				return false;
+			}
+			size_t i = 0;
+			for(auto& p : poses) {
+				if(_index->ids[i++] != p.first) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+	public:
+		PosePublisher() : _index(std::make_shared<PoseFrame::Index>()) { }
+
+		// By the main thread, once the whole frame is in.
+		void publish(const SlotMap<Tangible::Pose>& poses) {
+			if(!_indexes(poses)) {
+				std::shared_ptr<PoseFrame::Index> index = std::make_shared<PoseFrame::Index>();
+				for(auto& p : poses) {
+					index->byId[p.first] = (uint32_t)index->ids.size();
+					index->ids.push_back(p.first);
+				}
+				_index = index;
+			}
+
+			// Held by nobody but us: not the snapshot, and no reader that loaded it before
+			std::shared_ptr<PoseFrame> frame;
+			for(auto& f : _frames) {
+				if(f.use_count() == 1) {
+					// The count is read relaxed, see what the last reader did before letting go
+					std::atomic_thread_fence(std::memory_order_acquire);
+					frame = f;
+					break;
+				}
+			}
+			if(!frame) {
+				frame = std::make_shared<PoseFrame>();
+				_frames.push_back(frame);
+			}
+			frame->_index = _index;
+			frame->_poses.clear();
+			for(auto& p : poses) {
+				frame->_poses.push_back(p.second);
+			}
+			_snapshot.publish(frame);
+		}
+
+		std::shared_ptr<const PoseFrame> load() const { return _snapshot.load(); }
+	};
+
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <map>
+#include <algorithm>
+#include <set>
+#include <utility>
+#include <vector>
+#include <mutex>
+#include "cinder/Vector.h"
+#include "SequenceStore.h"
+#include "SpatialGrid.h"
+
+namespace SecondStudy {
+
+	// Incremental version of linkingAlgorithm.txt.
+	// Tangibles are only re-evaluated once they have moved further than a threshold
+	// from where they were last evaluated, so a still table costs nothing.
+	// What the user does by hand wins: a link made with a stroke is never undone by the
+	// linker, however far apart its ends end up, and a link cut with a stroke is never
+	// made again by it, until the user links the two by hand.
+	class ProximityLinker {
+	public:
+		struct Delta {
+			enum Type {
+				LINK,
+				UNLINK
+			} type;
+			int from;
+			int to;
+
+			Delta(Type t, int f, int o) : type(t), from(f), to(o) { }
+		};
+
+	private:
+		float _threshold;
+		std::map<int, ci::Vec2f> _positions; // latest known, in table space
+		std::map<int, ci::Vec2f> _evaluated; // where each tangible was when it was last evaluated
+		std::set<int> _dirty;
+		std::set<std::pair<int, int>> _pinned; // links made by hand
+		std::set<std::pair<int, int>> _cut; // links cut by hand
+		std::mutex _mutex;
+
+		bool _isPinned(int a, int b) const { return _pinned.count(std::make_pair(a, b)) > 0; }
+		bool _isCut(int a, int b) const { return _cut.count(std::make_pair(a, b)) > 0; }
+
+		// Can t be taken out of its sequence? Not if that undoes a link made by hand,
+		// or closing the gap makes one that was cut.
+		bool _canDetach(const SequenceStore& sequences, int t) const {
+			int p = sequences.prev(t);
+			int n = sequences.next(t);
+			return !(p != -1 && _isPinned(p, t)) && !(n != -1 && _isPinned(t, n)) && !(p != -1 && n != -1 && _isCut(p, n));
+		}
+
+		// Same for putting the lone t right before (or after) n.
+		bool _canInsert(const SequenceStore& sequences, int t, int n, bool after) const {
+			if(after) {
+				int o = sequences.next(n);
+				return !_isCut(n, t) && !(o != -1 && (_isPinned(n, o) || _isCut(t, o)));
+			}
+			int o = sequences.prev(n);
+			return !_isCut(t, n) && !(o != -1 && (_isPinned(o, n) || _isCut(o, t)));
+		}
+
+		// Takes t out of its sequence, closing the gap, and leaves it on its own.
+		void _detach(SequenceStore& sequences, int t, std::vector<Delta>& deltas) {
+			int p = sequences.prev(t);
+			int n = sequences.next(t);
+			if(p != -1) {
+				deltas.push_back(Delta(Delta::UNLINK, p, t));
+			}
+			if(n != -1) {
+				deltas.push_back(Delta(Delta::UNLINK, t, n));
+			}
+			if(p != -1 && n != -1) {
+				deltas.push_back(Delta(Delta::LINK, p, n));
+			}
+			sequences.detach(t);
+		}
+
+		// Moves the lone t into n's sequence, right before n (or right after it).
+		void _insert(SequenceStore& sequences, int t, int n, bool after, std::vector<Delta>& deltas, std::vector<int>& joined) {
+			if(sequences.head(t) == sequences.head(n)) {
+				return;
+			}
+			joined.push_back(t);
+			if(after) {
+				int o = sequences.next(n);
+				if(o != -1) {
+					deltas.push_back(Delta(Delta::UNLINK, n, o));
+					deltas.push_back(Delta(Delta::LINK, t, o));
+				}
+				deltas.push_back(Delta(Delta::LINK, n, t));
+				sequences.moveAfter(t, t, n);
+			} else {
+				int o = sequences.prev(n);
+				if(o != -1) {
+					deltas.push_back(Delta(Delta::UNLINK, o, n));
+					deltas.push_back(Delta(Delta::LINK, o, t));
+				}
+				deltas.push_back(Delta(Delta::LINK, t, n));
+				sequences.moveBefore(t, t, n);
+			}
+		}
+
+		void _evaluate(SequenceStore& sequences, int t, const std::vector<int>& neighbors, std::vector<Delta>& deltas, std::vector<int>& joined) {
+			// Where t goes once it's out of its sequence, if anywhere
+			int target = -1;
+			bool after = false;
+			if(neighbors.size() == 1) {
+				int n = neighbors[0];
+				if(sequences.next(t) == n || sequences.next(n) == t) {
+					return;
+				}
+				if(sequences.isHead(n)) {
+					target = n;
+				} else if(sequences.isTail(n)) {
+					target = n;
+					after = true;
+				}
+			} else if(neighbors.size() > 1) {
+				// n is the closest
+				int n = neighbors[0];
+				int m = neighbors[1];
+				int tn = sequences.next(t);
+				int nn = sequences.next(n);
+				int mn = sequences.next(m);
+				// Is t already in the middle of a sequence with them?
+				if(tn == n || tn == m || nn == t || mn == t) {
+					return;
+				}
+				if(nn != m && mn != n) {
+					// t is between two distinct sequences
+					if(sequences.isHead(n)) {
+						target = n;
+					} else if(sequences.isTail(n)) {
+						target = n;
+						after = true;
+					}
+				} else if(mn == n) {
+					target = m;
+					after = true;
+				} else {
+					target = n;
+					after = true;
+				}
+			}
+			// t isn't next to its target, so taking it out doesn't change what's around the target
+			if(!_canDetach(sequences, t) || (target != -1 && !_canInsert(sequences, t, target, after))) {
+				return;
+			}
+			_detach(sequences, t, deltas);
+			if(target != -1) {
+				_insert(sequences, t, target, after, deltas, joined);
+			}
+		}
+
+	public:
+		ProximityLinker(float threshold) : _threshold(threshold) { }
+
+		// p is in table space, same as the grid.
+		void moved(int id, ci::Vec2f p) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_positions[id] = p;
+			auto it = _evaluated.find(id);
+			if(it == _evaluated.end() || it->second.distance(p) > _threshold) {
+				_dirty.insert(id);
+			}
+		}
+
+		// Taken off the table. Where it was last evaluated is kept, so a tangible put back
+		// where it was before it timed out keeps its links, see forget().
+		void removed(int id) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_dirty.erase(id);
+			_positions.erase(id);
+		}
+
+		// Left its sequence for good. With the lock protecting sequences held.
+		void forget(int id) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_evaluated.erase(id);
+			auto involves = [id](const std::pair<int, int>& l) { return l.first == id || l.second == id; };
+			for(auto it = _pinned.begin(); it != _pinned.end();) {
+				it = involves(*it) ? _pinned.erase(it) : ++it;
+			}
+			for(auto it = _cut.begin(); it != _cut.end();) {
+				it = involves(*it) ? _cut.erase(it) : ++it;
+			}
+		}
+
+		// The user linked a -> b, or cut it. Like pass(), with the lock protecting sequences held.
+		void linkedByHand(int a, int b) {
+			_cut.erase(std::make_pair(a, b));
+			_pinned.insert(std::make_pair(a, b));
+		}
+
+		void cutByHand(int a, int b) {
+			_pinned.erase(std::make_pair(a, b));
+			_cut.insert(std::make_pair(a, b));
+		}
+
+		// Re-evaluates the tangibles that moved since the last pass. joined gets the
+		// tangibles that were put into another sequence.
+		// The caller must hold the lock protecting sequences.
+		std::vector<Delta> pass(SequenceStore& sequences, SpatialGrid& grid, float radius, std::vector<int>& joined) {
+			std::set<int> dirty;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				dirty.swap(_dirty);
+			}
+
+			// A link made by hand may have gone some other way since, e.g. a later stroke
+			for(auto it = _pinned.begin(); it != _pinned.end();) {
+				bool linked = sequences.contains(it->first) && sequences.next(it->first) == it->second;
+				it = linked ? ++it : _pinned.erase(it);
+			}
+
+			std::vector<Delta> deltas;
+			for(int id : dirty) {
+				if(!sequences.contains(id)) {
+					continue;
+				}
+				ci::Vec2f p;
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					p = _positions[id];
+					_evaluated[id] = p;
+				}
+
+				std::vector<int> neighbors = grid.nearest(p, radius, 0, id);
+				// Only tangibles in sequences take part, so never the play mode token (fiducial 0).
+				neighbors.erase(std::remove_if(neighbors.begin(), neighbors.end(), [&](int n) { return !sequences.contains(n); }), neighbors.end());
+				if(neighbors.size() > 2) {
+					neighbors.resize(2);
+				}
+				_evaluate(sequences, id, neighbors, deltas, joined);
+			}
+			return deltas;
+		}
+	};
+
+}
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+
+#include "SessionLog.h"
+#include "SessionTime.h"
+#include "StageStats.h"
+#include "Bench.h"
+#include "Checks.h"
+
+namespace SecondStudy {
+
+	static const char* tuioEventNames[TuioEvent::TYPES] = { "ca", "cu", "cr", "oa", "ou", "or" };
+	// The stages the replay times itself, one for each TUIO callback
+	static const char* tuioStageNames[TuioEvent::TYPES] = { "cursorAdded", "cursorUpdated", "cursorRemoved", "objectAdded", "objectUpdated", "objectRemoved" };
+
+	// Appends the events in path, either a segment of a binary session log (see SessionRecorder)
+	// or a session in text form, one event per line, blank lines and #comments skipped:
+	//   time type session fiducial x y angle xspeed yspeed
+	// type is ca, cu, cr, oa, ou or or: cursor or object added, updated or removed.
+	// run is that of the segments read so far, 0 before the first one: segments of
+	// different runs of the app don't go together.
+	inline bool readSession(const std::string& path, std::vector<TuioEvent>& events, uint64_t& run, std::string& error) {
+		SessionReader log;
+		if(log.open(path)) {
+			if(run != 0 && log.run() != run) {
+				error = path + ": segment of another run";
+				return false;
+			}
+			run = log.run();
+			if(log.size() > 0 && !events.empty() && log[0].time < events.back().time) {
+				error = path + ": segment out of order";
+				return false;
+			}
+			events.insert(events.end(), log.begin(), log.end());
+			return true;
+		}
+
+		std::ifstream in(path.c_str());
+		if(!in) {
+			error = "can't open " + path;
+			return false;
+		}
+		std::string line;
+		int n = 0;
+		while(std::getline(in, line)) {
+			n++;
+			std::istringstream fields(line);
+			std::string type;
+			TuioEvent e;
+			if(!(fields >> e.time)) {
+				fields.clear();
+				if(!(fields >> type) || type[0] == '#') {
+					continue;
+				}
+				std::ostringstream s;
+				s << path << ":" << n << ": expected a timestamp";
+				error = s.str();
+				return false;
+			}
+			fields >> type >> e.sessionId >> e.fiducialId >> e.x >> e.y >> e.angle >> e.xSpeed >> e.ySpeed;
+			e.type = TuioEvent::TYPES;
+			for(int i = 0; i < TuioEvent::TYPES; i++) {
+				if(type == tuioEventNames[i]) {
+					e.type = i;
+				}
+			}
+			if(!fields || e.type == TuioEvent::TYPES || (!events.empty() && e.time < events.back().time)) {
+				std::ostringstream s;
+				s << path << ":" << n << ": malformed or out of order event";
+				error = s.str();
+				return false;
+			}
+			events.push_back(e);
+		}
+		return true;
+	}
+
+	// A stage or a figure of the app and what it must come to by the end of a replay, from
+	// "name=value"
+	struct ReplayExpectation {
+		std::string stage;
+		double value;
+	};
+
+	inline bool parseExpectation(const std::string& arg, ReplayExpectation& e) {
+		size_t eq = arg.find('=');
+		if(eq == std::string::npos || eq == 0 || eq + 1 == arg.size()) {
+			return false;
+		}
+		e.stage = arg.substr(0, eq);
+		e.value = atof(arg.c_str() + eq + 1);
+		return true;
+	}
+
+	// Feeds a recorded session through App's TUIO callbacks and update(), with no window,
+	// then prints how fast that went, how long every stage took and the final state of
+	// the table. update() runs once every 1/fps seconds of session time, as it would live.
+	// By default the session runs as fast as it can; --realtime keeps to its timestamps.
+	// Either way session time is what the app sees, so both should end up in the same state.
+	// Several files are played one after the other, e.g. the segments of a session log,
+	// and session time starts at the first event. --expect stage=count and --budget
+	// stage=ms make it a test: the exit status is 1 unless the stage ran exactly count
+	// times, or never took longer than ms. The same goes for the figures App gives
+	// forEachFigure(), with --expect figure=value and --limit figure=max. --bench and
+	// --check run one of the benchmarks in Bench.h or the checks in Checks.h instead.
+	template<class App>
+	int replayMain(int argc, char* argv[], float fps) {
+		if(argc > 1 && std::string(argv[1]) == "--bench") {
+			return benchMain(argc, argv);
+		}
+		if(argc > 1 && std::string(argv[1]) == "--check") {
+			return checkMain(argc, argv);
+		}
+		bool realtime = false;
+		bool verbose = false;
+		double tail = 2.0; // seconds of session time after the last event, so that everything times out
+		std::vector<std::string> paths;
+		std::vector<ReplayExpectation> counts, budgets, limits;
+		bool usage = false;
+		for(int i = 1; i < argc; i++) {
+			std::string arg(argv[i]);
+			ReplayExpectation expectation;
+			if(arg == "--realtime") {
+				realtime = true;
+			} else if(arg == "--verbose") {
+				verbose = true;
+			} else if(arg == "--tail" && i + 1 < argc) {
+				tail = atof(argv[++i]);
+			} else if(arg == "--expect" && i + 1 < argc) {
+				usage |= !parseExpectation(argv[++i], expectation);
+				counts.push_back(expectation);
+			} else if(arg == "--budget" && i + 1 < argc) {
+				usage |= !parseExpectation(argv[++i], expectation);
+				budgets.push_back(expectation);
+			} else if(arg == "--limit" && i + 1 < argc) {
+				usage |= !parseExpectation(argv[++i], expectation);
+				limits.push_back(expectation);
+			} else {
+				paths.push_back(arg);
+			}
+		}
+		if(paths.empty() || usage) {
+			std::cerr << "usage: " << argv[0] << " [--realtime] [--verbose] [--tail seconds] [--expect stage=count] [--budget stage=ms] [--limit figure=max] session..." << std::endl;
+			return 1;
+		}
+
+		std::vector<TuioEvent> events;
+		uint64_t run = 0;
+		std::string error;
+		for(auto& path : paths) {
+			if(!readSession(path, events, run, error)) {
+				std::cerr << error << std::endl;
+				return 1;
+			}
+		}
+		if(!events.empty()) {
+			double first = events.front().time;
+			for(auto& e : events) {
+				e.time -= first;
+			}
+		}
+
+		App app;
+		app.setVerbose(verbose);
+		app.setup();
+
+		StageStats stats[TuioEvent::TYPES];
+		StageStats update;
+		double frame = 1.0 / fps;
+		double now = 0.0;
+		double end = (events.empty() ? 0.0 : events.back().time) + tail;
+		StageStats::Clock::time_point start = StageStats::Clock::now();
+
+		auto advance = [&](double t) {
+			replayTime() = t;
+			if(realtime) {
+				std::this_thread::sleep_until(start + std::chrono::duration_cast<StageStats::Clock::duration>(std::chrono::duration<double>(t)));
+			}
+		};
+
+		auto e = events.begin();
+		while(now <= end) {
+			for(; e != events.end() && e->time < now; ++e) {
+				advance(e->time);
+				StageStats::Scope scope(stats[e->type]);
+				switch(e->type) {
+				case TuioEvent::CURSOR_ADDED: app.cursorAdded(e->cursor()); break;
+				case TuioEvent::CURSOR_UPDATED: app.cursorUpdated(e->cursor()); break;
+				case TuioEvent::CURSOR_REMOVED: app.cursorRemoved(e->cursor()); break;
+				case TuioEvent::OBJECT_ADDED: app.objectAdded(e->object()); break;
+				case TuioEvent::OBJECT_UPDATED: app.objectUpdated(e->object()); break;
+				case TuioEvent::OBJECT_REMOVED: app.objectRemoved(e->object()); break;
+				}
+			}
+			advance(now);
+			{
+				StageStats::Scope scope(update);
+				app.update();
+			}
+			now += frame;
+		}
+
+		// Lets the gesture thread drain its queue
+		app.shutdown();
+		double wall = std::chrono::duration<double>(StageStats::Clock::now() - start).count();
+
+		std::ostream& out = std::cout;
+		out << std::fixed << std::setprecision(3);
+		out << "session       " << paths.front() << (paths.size() > 1 ? " ..." : "") << std::endl;
+		out << "events        " << events.size() << std::endl;
+		out << "session time  " << end << " s" << std::endl;
+		out << "wall time     " << wall << " s" << std::endl;
+		out << "events/s      " << (wall > 0.0 ? events.size() / wall : 0.0) << std::endl;
+		out << std::endl;
+		StageStats::header(out);
+		for(int i = 0; i < TuioEvent::TYPES; i++) {
+			stats[i].print(out, tuioStageNames[i]);
+		}
+		update.print(out, "update");
+		app.forEachStage([&](const char* name, const StageStats& s) { s.print(out, name); });
+		out << std::endl;
+		app.report(out);
+
+		std::map<std::string, const StageStats*> stages;
+		for(int i = 0; i < TuioEvent::TYPES; i++) {
+			stages[tuioStageNames[i]] = &stats[i];
+		}
+		stages["update"] = &update;
+		app.forEachStage([&](const char* name, const StageStats& s) { stages[name] = &s; });
+		std::map<std::string, double> figures;
+		app.forEachFigure([&](const char* name, double value) { figures[name] = value; });
+		size_t failed = 0;
+		for(auto& c : counts) {
+			auto it = stages.find(c.stage);
+			auto figure = figures.find(c.stage);
+			if(it != stages.end()) {
+				if(it->second->count() != (long)c.value) {
+					out << c.stage << " ran " << it->second->count() << " times, expected " << (long)c.value << std::endl;
+					failed++;
+				}
+			} else if(figure != figures.end()) {
+				if(figure->second != c.value) {
+					out << c.stage << " came to " << figure->second << ", expected " << c.value << std::endl;
+					failed++;
+				}
+			} else {
+				out << "no stage or figure called " << c.stage << std::endl;
+				failed++;
+			}
+		}
+		for(auto& b : budgets) {
+			auto it = stages.find(b.stage);
+			if(it == stages.end()) {
+				out << "no stage called " << b.stage << std::endl;
+				failed++;
+			} else if(it->second->max() > b.value * 1000.0) {
+				out << b.stage << " took up to " << it->second->max() / 1000.0 << " ms, over its budget of " << b.value << " ms" << std::endl;
+				failed++;
+			}
+		}
+		for(auto& l : limits) {
+			auto it = figures.find(l.stage);
+			if(it == figures.end()) {
+				out << "no figure called " << l.stage << std::endl;
+				failed++;
+			} else if(it->second > l.value) {
+				out << l.stage << " came to " << it->second << ", over its limit of " << l.value << std::endl;
+				failed++;
+			}
+		}
+		size_t expectations = counts.size() + budgets.size() + limits.size();
+		if(expectations > 0) {
+			out << expectations - failed << " of " << expectations << " expectations met" << std::endl;
+		}
+		return failed > 0 ? 1 : 0;
+	}
+
+}
+
+// Stands in for CINDER_APP_NATIVE in headless builds.
+#define SECONDSTUDY_REPLAY_MAIN(APP, FPS) \
+	int main(int argc, char* argv[]) { \
+		return SecondStudy::replayMain<APP>(argc, argv, FPS); \
+	}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <algorithm>
+
+#if defined(SECONDSTUDY_HEADLESS)
+#include "SessionTime.h"
+#endif
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace SecondStudy {
+
+	// Step clock for playback. Step times are derived from the start time, never
+	// accumulated, so they don't drift, and they don't depend on the render loop at all.
+	// Every step is collected a little ahead of time (the lookahead) and emitted when
+	// it's due, or emitAhead before that if the receiver can hold on to timestamped
+	// events until they are due. What's common to the threaded scheduler and the one
+	// headless replays poll, on clock C.
+	template<class C>
+	class StepScheduler {
+	public:
+		typedef C Clock;
+		typedef std::function<void(int step, typename Clock::time_point when, std::vector<int>& notes)> CollectFn;
+		typedef std::function<void(typename Clock::time_point when, const std::vector<int>& notes)> EmitFn;
+
+	protected:
+		CollectFn _collect;
+		EmitFn _emit;
+
+		std::mutex _mutex;
+		std::condition_variable _cv;
+		bool _running;
+		bool _shouldStop;
+		unsigned int _generation; // bumped by start() and stop() to abandon the step being waited on
+
+		typename Clock::duration _stepLength;
+		typename Clock::duration _lookahead;
+		typename Clock::duration _emitAhead;
+		typename Clock::time_point _start;
+		int _step;
+		std::vector<int> _notes;
+
+		double _lateness; // ms, running mean
+		double _maxLateness; // ms
+		long _emitted;
+
+		// After a step went out late ms after it should have, with the lock held
+		void _ran(unsigned int generation, double late) {
+			_emitted++;
+			_lateness += (late - _lateness) / _emitted;
+			_maxLateness = std::max(_maxLateness, late);
+			if(generation == _generation) {
+				_step++;
+			}
+		}
+
+	public:
+		StepScheduler(CollectFn collect, EmitFn emit, typename Clock::duration lookahead, typename Clock::duration emitAhead) : _collect(collect), _emit(emit), _lookahead(lookahead), _emitAhead(emitAhead) {
+			_running = false;
+			_shouldStop = false;
+			_generation = 0;
+			_step = 0;
+			_lateness = 0.0;
+			_maxLateness = 0.0;
+			_emitted = 0;
+		}
+
+		// (Re)starts counting steps from 0, the first one due right now.
+		void start(double stepLength) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stepLength = std::chrono::duration_cast<typename Clock::duration>(std::chrono::duration<double>(stepLength));
+			_start = Clock::now() + _lookahead;
+			_step = 0;
+			_running = true;
+			_generation++;
+			_cv.notify_all();
+		}
+
+		void stop() {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_running = false;
+			_generation++;
+			_cv.notify_all();
+		}
+
+		// How late notes were emitted, in milliseconds.
+		double lateness() {
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _lateness;
+		}
+
+		double maxLateness() {
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _maxLateness;
+		}
+	};
+
+	// The scheduler the app plays with, on its own high priority thread and the wall
+	// clock. Also built headless, for --bench scheduler.
+	class ThreadedScheduler : public StepScheduler<std::chrono::steady_clock> {
+		std::thread _thread;
+
+		static void _raisePriority() {
+#if defined(_WIN32)
+			SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#else
+			// Best effort, this needs privileges on some systems.
+			sched_param param;
+			param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+			pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#endif
+		}
+
+		void _loop() {
+			_raisePriority();
+			std::unique_lock<std::mutex> lock(_mutex);
+			while(!_shouldStop) {
+				if(!_running) {
+					_cv.wait(lock);
+					continue;
+				}
+				unsigned int generation = _generation;
+				Clock::time_point due = _start + _stepLength * _step;
+				while(!_shouldStop && generation == _generation && Clock::now() < due - _lookahead) {
+					_cv.wait_until(lock, due - _lookahead);
+				}
+				if(_shouldStop || generation != _generation) {
+					continue;
+				}
+				int step = _step;
+				lock.unlock();
+
+				_notes.clear();
+				_collect(step, due, _notes);
+
+				// Sleep for most of what's left, then spin for the last stretch:
+				// OS sleeps are only good to a millisecond or (much) worse.
+				Clock::time_point emit = due - _emitAhead;
+				std::this_thread::sleep_until(emit - std::chrono::milliseconds(2));
+				while(Clock::now() < emit) {
+					std::this_thread::yield();
+				}
+				_emit(due, _notes);
+				double late = std::chrono::duration<double, std::milli>(Clock::now() - emit).count();
+
+				lock.lock();
+				_ran(generation, late);
+			}
+		}
+
+	public:
+		ThreadedScheduler(CollectFn collect, EmitFn emit, Clock::duration lookahead, Clock::duration emitAhead = Clock::duration::zero()) : StepScheduler<Clock>(collect, emit, lookahead, emitAhead) {
+			_thread = std::thread(std::bind(&ThreadedScheduler::_loop, this));
+		}
+
+		~ThreadedScheduler() {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_shouldStop = true;
+				_cv.notify_all();
+			}
+			_thread.join();
+		}
+	};
+
+#if defined(SECONDSTUDY_HEADLESS)
+	// Headless there is no thread and no wall clock: steps are due in replay time, and
+	// update() calls poll() to run the ones that are.
+	class PolledScheduler : public StepScheduler<ReplayClock> {
+	public:
+		PolledScheduler(CollectFn collect, EmitFn emit, Clock::duration lookahead, Clock::duration emitAhead = Clock::duration::zero()) : StepScheduler<Clock>(collect, emit, lookahead, emitAhead) { }
+
+		// Collects and emits, in order, every step that the thread would have collected by
+		// now. Lateness is how far past its collection time a step was run, which is down
+		// to how often this is called, not how accurate the timing is: for that, see
+		// --bench scheduler.
+		void poll() {
+			std::unique_lock<std::mutex> lock(_mutex);
+			while(_running) {
+				unsigned int generation = _generation;
+				Clock::time_point due = _start + _stepLength * _step;
+				Clock::time_point now = Clock::now();
+				if(now < due - _lookahead) {
+					break;
+				}
+				int step = _step;
+				lock.unlock();
+
+				_notes.clear();
+				_collect(step, due, _notes);
+				_emit(due, _notes);
+				double late = std::chrono::duration<double, std::milli>(now - (due - _lookahead)).count();
+
+				lock.lock();
+				_ran(generation, late);
+			}
+		}
+	};
+
+	typedef PolledScheduler Scheduler;
+#else
+	typedef ThreadedScheduler Scheduler;
+#endif
+
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "cinder/Vector.h"
+
+namespace SecondStudy {
+
+	// Uniform grid of the links between tangibles, as segments keyed by the ID of the
+	// tangible they start from (a tangible links to one other at most). Every segment is
+	// stored in each cell it passes through, so a polyline is only tested against the
+	// segments sharing a cell with it. Positions and links are set separately, and a
+	// segment follows both ends as they move.
+	class SegmentGrid {
+		struct Segment {
+			int to;
+			std::vector<int> cells;
+			unsigned int stamp; // last polyline segment that tested it
+			unsigned int crossed; // last crossings() that found it crossed
+		};
+
+		int _cols, _rows;
+		float _cellSize;
+		std::vector<std::vector<int>> _cells;
+		std::map<int, ci::Vec2f> _positions;
+		std::map<int, Segment> _segments; // by the tangible they start from
+		std::map<int, int> _from; // the other way around
+		unsigned int _stamp;
+		unsigned int _query;
+		std::vector<std::pair<double, int>> _found; // scratch for crossings()
+		std::mutex _mutex;
+
+		int _cellX(float x) const { return std::min(std::max((int)(x / _cellSize), 0), _cols - 1); }
+		int _cellY(float y) const { return std::min(std::max((int)(y / _cellSize), 0), _rows - 1); }
+
+		// Calls f(cell) for every cell a -> b passes through, in order (Amanatides and Woo).
+		// Ends off the grid count as being in the nearest cell.
+		template<typename F>
+		void _forEachCell(ci::Vec2f a, ci::Vec2f b, F f) const {
+			int x = _cellX(a.x), y = _cellY(a.y);
+			int x1 = _cellX(b.x), y1 = _cellY(b.y);
+			int stepX = x1 > x ? 1 : -1;
+			int stepY = y1 > y ? 1 : -1;
+			ci::Vec2f d = b - a;
+			// How far along a -> b the next vertical and horizontal cell boundaries are, and the distance between them
+			float tx = d.x != 0.0f ? ((x + (stepX > 0 ? 1 : 0)) * _cellSize - a.x) / d.x : INFINITY;
+			float ty = d.y != 0.0f ? ((y + (stepY > 0 ? 1 : 0)) * _cellSize - a.y) / d.y : INFINITY;
+			float dx = d.x != 0.0f ? _cellSize / std::abs(d.x) : INFINITY;
+			float dy = d.y != 0.0f ? _cellSize / std::abs(d.y) : INFINITY;
+			f(y * _cols + x);
+			for(int n = std::abs(x1 - x) + std::abs(y1 - y); n > 0; n--) {
+				// Once a coordinate is at its last cell only the other one may move
+				if(y == y1 || (x != x1 && tx < ty)) {
+					x += stepX;
+					tx += dx;
+				} else {
+					y += stepY;
+					ty += dy;
+				}
+				f(y * _cols + x);
+			}
+		}
+
+		void _unlink(int from) {
+			auto it = _segments.find(from);
+			if(it == _segments.end()) {
+				return;
+			}
+			for(int c : it->second.cells) {
+				std::vector<int>& cell = _cells[c];
+				cell.erase(std::remove(cell.begin(), cell.end(), from), cell.end());
+			}
+			it->second.cells.clear();
+		}
+
+		// (Re)files the segment starting at from under the cells it passes through now.
+		void _link(int from) {
+			auto it = _segments.find(from);
+			if(it == _segments.end()) {
+				return;
+			}
+			_unlink(from);
+			auto a = _positions.find(from);
+			auto b = _positions.find(it->second.to);
+			if(a == _positions.end() || b == _positions.end()) {
+				return;
+			}
+			Segment& s = it->second;
+			_forEachCell(a->second, b->second, [&](int c) {
+				_cells[c].push_back(from);
+				s.cells.push_back(c);
+			});
+		}
+
+		// How far along a -> b it crosses p -> q, from 0 to 1
+		static double _along(ci::Vec2f a, ci::Vec2f b, ci::Vec2f p, ci::Vec2f q) {
+			double da = std::abs(orientation(p, q, a)), db = std::abs(orientation(p, q, b));
+			return da / (da + db + 1e-30);
+		}
+
+	public:
+		SegmentGrid(ci::Vec2f size, float cellSize) : _cellSize(cellSize), _stamp(0), _query(0) {
+			_cols = std::max(1, (int)ceil(size.x / cellSize));
+			_rows = std::max(1, (int)ceil(size.y / cellSize));
+			_cells.resize(_cols * _rows);
+		}
+
+		// Sign of the turn a -> b -> c: positive if counterclockwise, negative if clockwise,
+		// 0 if they are collinear. Done in double, where the products of the float
+		// coordinate differences are exact, so the sign can be trusted.
+		static double orientation(ci::Vec2f a, ci::Vec2f b, ci::Vec2f c) {
+			return ((double)b.x - a.x) * ((double)c.y - a.y) - ((double)b.y - a.y) * ((double)c.x - a.x);
+		}
+
+		// Do the closed segments ab and cd have a point in common? Vertical, degenerate
+		// and collinear segments included.
+		static bool intersect(ci::Vec2f a, ci::Vec2f b, ci::Vec2f c, ci::Vec2f d) {
+			double abc = orientation(a, b, c), abd = orientation(a, b, d);
+			double cda = orientation(c, d, a), cdb = orientation(c, d, b);
+			if(((abc > 0.0 && abd < 0.0) || (abc < 0.0 && abd > 0.0)) && ((cda > 0.0 && cdb < 0.0) || (cda < 0.0 && cdb > 0.0))) {
+				return true;
+			}
+			// Otherwise they only meet if an end of one lies on the other
+			auto within = [](ci::Vec2f p, ci::Vec2f q, ci::Vec2f r) {
+				return std::min(p.x, q.x) <= r.x && r.x <= std::max(p.x, q.x) && std::min(p.y, q.y) <= r.y && r.y <= std::max(p.y, q.y);
+			};
+			return (abc == 0.0 && within(a, b, c)) || (abd == 0.0 && within(a, b, d)) || (cda == 0.0 && within(c, d, a)) || (cdb == 0.0 && within(c, d, b));
+		}
+
+		void move(int id, ci::Vec2f position) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_positions[id] = position;
+			_link(id);
+			auto it = _from.find(id);
+			if(it != _from.end()) {
+				_link(it->second);
+			}
+		}
+
+		// Links from -> to, replacing whatever from linked to before. Only the cells of this
+		// segment are touched.
+		void addLink(int from, int to) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto it = _segments.find(from);
+			if(it != _segments.end()) {
+				auto back = _from.find(it->second.to);
+				if(back != _from.end() && back->second == from) {
+					_from.erase(back);
+				}
+			} else {
+				it = _segments.insert(std::make_pair(from, Segment())).first;
+				it->second.stamp = 0;
+				it->second.crossed = 0;
+			}
+			it->second.to = to;
+			_from[to] = from;
+			_link(from);
+		}
+
+		void removeLink(int from) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto it = _segments.find(from);
+			if(it == _segments.end()) {
+				return;
+			}
+			_unlink(from);
+			auto back = _from.find(it->second.to);
+			if(back != _from.end() && back->second == from) {
+				_from.erase(back);
+			}
+			_segments.erase(it);
+		}
+
+		// The link a -> b crosses first, by the ID it starts from, -1 if none. Allocates nothing,
+		// for testing a stroke piece by piece as it comes in.
+		int firstCrossing(ci::Vec2f a, ci::Vec2f b) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stamp++;
+			int first = -1;
+			double firstT = 2.0;
+			_forEachCell(a, b, [&](int c) {
+				for(int from : _cells[c]) {
+					Segment& s = _segments[from];
+					if(s.stamp == _stamp) {
+						continue;
+					}
+					s.stamp = _stamp;
+					ci::Vec2f p = _positions[from], q = _positions[s.to];
+					if(intersect(a, b, p, q) && _along(a, b, p, q) < firstT) {
+						firstT = _along(a, b, p, q);
+						first = from;
+					}
+				}
+			});
+			return first;
+		}
+
+		// The from -> to links the polyline crosses, in the order it crosses them first.
+		std::vector<std::pair<int, int>> crossings(const std::vector<ci::Vec2f>& polyline) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			std::vector<std::pair<int, int>> result;
+			// Links already crossed are marked with the query, so they're only reported once
+			_query++;
+			for(size_t i = 1; i < polyline.size(); i++) {
+				ci::Vec2f a = polyline[i - 1], b = polyline[i];
+				// Segments span several cells, stamp them so each is only tested once per piece of the polyline
+				_stamp++;
+				std::vector<std::pair<double, int>>& found = _found;
+				found.clear();
+				_forEachCell(a, b, [&](int c) {
+					for(int from : _cells[c]) {
+						Segment& s = _segments[from];
+						if(s.stamp == _stamp || s.crossed == _query) {
+							continue;
+						}
+						s.stamp = _stamp;
+						ci::Vec2f p = _positions[from], q = _positions[s.to];
+						if(intersect(a, b, p, q)) {
+							found.push_back(std::make_pair(_along(a, b, p, q), from));
+						}
+					}
+				});
+				std::sort(found.begin(), found.end());
+				for(auto& f : found) {
+					Segment& s = _segments[f.second];
+					s.crossed = _query;
+					result.push_back(std::make_pair(f.second, s.to));
+				}
+			}
+			return result;
+		}
+	};
+
+}
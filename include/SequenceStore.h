@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vector>
+
+namespace SecondStudy {
+
+	class Tangible;
+
+	// All the sequences on the table, as doubly linked chains threaded through one flat
+	// array indexed by fiducial ID. Successor, head, "which sequence is X in", cut and
+	// splice are all constant time link-wise; the only linear work is re-labelling the
+	// head of the nodes that actually change sequence.
+	// Holds plain pointers: the tangibles are owned by TheApp::_objects and never freed.
+	class SequenceStore {
+		struct Node {
+			Tangible* tangible;
+			int prev;
+			int next;
+			int head; // doubles as the sequence ID
+			bool used;
+
+			Node() : tangible(nullptr), prev(-1), next(-1), head(-1), used(false) { }
+		};
+
+		std::vector<Node> _nodes;
+
+		void _relabel(int head) {
+			for(int i = head; i != -1; i = _nodes[i].next) {
+				_nodes[i].head = head;
+			}
+		}
+
+		// Unhooks [first, last] from its sequence and closes the gap.
+		void _unlink(int first, int last) {
+			int p = _nodes[first].prev;
+			int n = _nodes[last].next;
+			_nodes[first].prev = -1;
+			_nodes[last].next = -1;
+			if(p != -1) {
+				_nodes[p].next = n;
+			}
+			if(n != -1) {
+				_nodes[n].prev = p;
+				if(p == -1) {
+					_relabel(n);
+				}
+			}
+			_relabel(first);
+		}
+
+		// Hooks the loose chain [first, last] in between p and n, either of which may be -1.
+		void _link(int first, int last, int p, int n) {
+			_nodes[first].prev = p;
+			_nodes[last].next = n;
+			if(p != -1) {
+				_nodes[p].next = first;
+			}
+			if(n != -1) {
+				_nodes[n].prev = last;
+			}
+			_relabel(p != -1 ? _nodes[p].head : first);
+		}
+
+	public:
+		bool contains(int id) const { return id >= 0 && id < (int)_nodes.size() && _nodes[id].used; }
+
+		// Adds t as a sequence of its own. Does nothing if it's already in one.
+		void add(int id, Tangible* t) {
+			if(id >= (int)_nodes.size()) {
+				_nodes.resize(id + 1);
+			}
+			if(!_nodes[id].used) {
+				_nodes[id] = Node();
+				_nodes[id].tangible = t;
+				_nodes[id].head = id;
+				_nodes[id].used = true;
+			}
+		}
+
+		// Takes id out of the store altogether, closing the gap it leaves.
+		void remove(int id) {
+			if(contains(id)) {
+				_unlink(id, id);
+				_nodes[id] = Node();
+			}
+		}
+
+		Tangible* tangible(int id) const { return _nodes[id].tangible; }
+		int next(int id) const { return _nodes[id].next; }
+		int prev(int id) const { return _nodes[id].prev; }
+		int head(int id) const { return _nodes[id].head; }
+		bool isHead(int id) const { return _nodes[id].prev == -1; }
+		bool isTail(int id) const { return _nodes[id].next == -1; }
+
+		// What plays after id, wrapping around at the end of the sequence.
+		int successor(int id) const { return _nodes[id].next != -1 ? _nodes[id].next : _nodes[id].head; }
+
+		int tail(int id) const {
+			while(_nodes[id].next != -1) {
+				id = _nodes[id].next;
+			}
+			return id;
+		}
+
+		// Is a somewhere before b in the same sequence?
+		bool precedes(int a, int b) const {
+			for(int i = _nodes[b].prev; i != -1; i = _nodes[i].prev) {
+				if(i == a) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		std::vector<int> heads() const {
+			std::vector<int> v;
+			for(int i = 0; i < (int)_nodes.size(); i++) {
+				if(_nodes[i].used && _nodes[i].prev == -1) {
+					v.push_back(i);
+				}
+			}
+			return v;
+		}
+
+		// Calls f(a, b) for every link a -> b.
+		template<typename F>
+		void forEachLink(F f) const {
+			for(int i = 0; i < (int)_nodes.size(); i++) {
+				if(_nodes[i].used && _nodes[i].next != -1) {
+					f(i, _nodes[i].next);
+				}
+			}
+		}
+
+		// Whatever follows id becomes a sequence of its own.
+		void cut(int id) {
+			int n = _nodes[id].next;
+			if(n != -1) {
+				_unlink(n, tail(n));
+			}
+		}
+
+		// Takes id out of its sequence, closing the gap, and leaves it on its own.
+		void detach(int id) {
+			_unlink(id, id);
+		}
+
+		// Moves [first, last] right before (or after) n. They must be in the same sequence, in that order.
+		void moveBefore(int first, int last, int n) {
+			_unlink(first, last);
+			_link(first, last, _nodes[n].prev, n);
+		}
+
+		void moveAfter(int first, int last, int n) {
+			_unlink(first, last);
+			_link(first, last, n, _nodes[n].next);
+		}
+	};
+
+}
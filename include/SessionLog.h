@@ -0,0 +1,354 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <ctime>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "TuioCursor.h"
+#include "TuioObject.h"
+#include "MappedFile.h"
+#include "SessionTime.h"
+
+#define SESSION_LOG_MAGIC "SSTUIO01"
+#define SESSION_LOG_EXTENSION ".tuiolog"
+
+namespace SecondStudy {
+
+	// One TUIO callback, as it came in. Cursors have no fiducial (-1) and no angle.
+	// This is also the record of the binary session log, so it has a fixed layout.
+	struct TuioEvent {
+		enum Type {
+			CURSOR_ADDED,
+			CURSOR_UPDATED,
+			CURSOR_REMOVED,
+			OBJECT_ADDED,
+			OBJECT_UPDATED,
+			OBJECT_REMOVED,
+			TYPES
+		};
+
+		double time; // seconds, see elapsedSeconds()
+		int32_t type;
+		int32_t sessionId;
+		int32_t fiducialId;
+		float x, y;
+		float angle;
+		float xSpeed, ySpeed;
+
+		bool isCursor() const { return type <= CURSOR_REMOVED; }
+
+		ci::tuio::Cursor cursor() const {
+			return ci::tuio::Cursor("replay", sessionId, ci::Vec2f(x, y), ci::Vec2f(xSpeed, ySpeed), 0.0f);
+		}
+
+		ci::tuio::Object object() const {
+			return ci::tuio::Object("replay", sessionId, fiducialId, ci::Vec2f(x, y), angle, ci::Vec2f(xSpeed, ySpeed), 0.0f, 0.0f, 0.0f);
+		}
+	};
+
+	static_assert(sizeof(TuioEvent) == 40, "TuioEvent is an on-disk record");
+
+	// First bytes of every log segment, the records follow right after.
+	struct SessionLogHeader {
+		char magic[8];
+		uint32_t recordSize;
+		uint32_t capacity;
+		uint64_t segment; // sequence number, counting from the start of the recording
+		volatile uint64_t count; // records written so far, only ever grows
+		uint64_t run; // when the recording started, microseconds since 1970, the same in all its segments
+		char reserved[24];
+	};
+
+	static_assert(sizeof(SessionLogHeader) == 64, "SessionLogHeader is on disk");
+
+	// The names of the files in the directory of base whose names are base's followed by
+	// a dot and end in SESSION_LOG_EXTENSION, in name order, with the directory.
+	inline std::vector<std::string> sessionLogFiles(const std::string& base) {
+		size_t slash = base.find_last_of("/\\");
+		std::string dir = slash == std::string::npos ? "." : base.substr(0, slash);
+		std::string prefix = (slash == std::string::npos ? base : base.substr(slash + 1)) + ".";
+		std::string suffix = SESSION_LOG_EXTENSION;
+		std::vector<std::string> names;
+		auto matches = [&](const std::string& name) {
+			return name.size() > prefix.size() + suffix.size() && name.compare(0, prefix.size(), prefix) == 0 && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+		};
+#if defined(_WIN32)
+		WIN32_FIND_DATAA found;
+		HANDLE h = FindFirstFileA((dir + "\\*").c_str(), &found);
+		if(h != INVALID_HANDLE_VALUE) {
+			do {
+				if(matches(found.cFileName)) {
+					names.push_back(found.cFileName);
+				}
+			} while(FindNextFileA(h, &found));
+			FindClose(h);
+		}
+#else
+		DIR* d = opendir(dir.c_str());
+		if(d != nullptr) {
+			while(dirent* e = readdir(d)) {
+				if(matches(e->d_name)) {
+					names.push_back(e->d_name);
+				}
+			}
+			closedir(d);
+		}
+#endif
+		std::sort(names.begin(), names.end());
+		for(auto& name : names) {
+			name = dir + "/" + name;
+		}
+		return names;
+	}
+
+	// Always-on recorder of the TUIO traffic, as a rotating set of memory mapped files
+	// named <base>.<run>.<segment>.tuiolog, each holding a fixed number of records. The
+	// run is the local time the recorder was started, YYYYMMDD-HHMMSS, so every launch
+	// starts a set of segments of its own and a crashed one is never written over. The
+	// segments kept are the last ones across runs, older runs are deleted first, and
+	// the ones open for writing count too: there are never more than keep on disk.
+	// record() is meant to be called from the TUIO thread only, and it never blocks or
+	// allocates: it copies one record into the mapped segment. Creating, mapping, closing
+	// and deleting files happens on a thread of its own, which always keeps the next
+	// segment ready. Should that ever fall behind, events are dropped and counted.
+	class SessionRecorder {
+		struct Segment {
+			MappedFile file;
+			SessionLogHeader* header;
+			TuioEvent* records;
+			std::string path;
+		};
+
+		std::string _base; // with the run
+		uint32_t _capacity;
+		size_t _keepClosed; // keep less the segment being written and the spare
+		uint64_t _run;
+
+		Segment* _current; // only touched by record()
+		std::atomic<Segment*> _spare;
+		std::atomic<Segment*> _retired;
+		uint64_t _nextSegment; // only touched by the rotation thread once started
+		std::atomic<long> _dropped;
+
+		std::deque<std::string> _closed;
+		std::thread _thread;
+		std::mutex _mutex;
+		std::condition_variable _cv;
+		std::atomic<bool> _shouldStop;
+
+		Segment* _open() {
+			char name[32];
+			sprintf(name, ".%06llu", (unsigned long long)_nextSegment);
+			Segment* s = new Segment();
+			s->path = _base + name + SESSION_LOG_EXTENSION;
+			if(!s->file.create(s->path, sizeof(SessionLogHeader) + _capacity * sizeof(TuioEvent))) {
+				delete s;
+				return nullptr;
+			}
+			// Touch every page now, so record() never has to wait for the OS to provide one
+			memset(s->file.data(), 0, s->file.size());
+			s->header = (SessionLogHeader*)s->file.data();
+			memcpy(s->header->magic, SESSION_LOG_MAGIC, sizeof(s->header->magic));
+			s->header->recordSize = sizeof(TuioEvent);
+			s->header->capacity = _capacity;
+			s->header->segment = _nextSegment++;
+			s->header->count = 0;
+			s->header->run = _run;
+			s->records = (TuioEvent*)(s->file.data() + sizeof(SessionLogHeader));
+			return s;
+		}
+
+		void _close(Segment* s) {
+			s->file.close(sizeof(SessionLogHeader) + (size_t)s->header->count * sizeof(TuioEvent));
+			_closed.push_back(s->path);
+			_prune();
+			delete s;
+		}
+
+		void _prune() {
+			while(_closed.size() > _keepClosed) {
+				std::remove(_closed.front().c_str());
+				_closed.pop_front();
+			}
+		}
+
+		// A run name no segment in files has yet: the time, and a counter if need be,
+		// should two launches come within a second. The counter goes after an underscore,
+		// which sorts after the dot that follows a run name without one, so the runs of
+		// one second still sort in the order they were started.
+		static std::string _runName(const std::string& base, uint64_t run, const std::vector<std::string>& files) {
+			time_t t = (time_t)(run / 1000000);
+			char stamp[32];
+			strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&t));
+			auto leaf = [](const std::string& path) {
+				size_t slash = path.find_last_of("/\\");
+				return slash == std::string::npos ? path : path.substr(slash + 1);
+			};
+			std::string name = stamp;
+			for(int n = 2; ; n++) {
+				std::string prefix = leaf(base) + "." + name + ".";
+				bool taken = false;
+				for(auto& path : files) {
+					taken = taken || leaf(path).compare(0, prefix.size(), prefix) == 0;
+				}
+				if(!taken) {
+					return name;
+				}
+				char counter[8];
+				sprintf(counter, "_%02d", n);
+				name = std::string(stamp) + counter;
+			}
+		}
+
+		void _loop() {
+			std::unique_lock<std::mutex> lock(_mutex);
+			while(!_shouldStop.load()) {
+				Segment* retired = _retired.exchange(nullptr);
+				if(retired != nullptr) {
+					_close(retired);
+				}
+				if(_spare.load() == nullptr) {
+					_spare.store(_open());
+				}
+				// record() doesn't take the lock to wake us up, so don't trust the notification alone.
+				_cv.wait_for(lock, std::chrono::milliseconds(100));
+			}
+		}
+
+	public:
+		// Keeps the last keep segments of capacity records each, of this run and earlier
+		// ones, older ones are deleted. keep is at least 2: the segment being written
+		// and the one ready to take over.
+		SessionRecorder(const std::string& base, uint32_t capacity, size_t keep) : _capacity(capacity), _keepClosed(keep > 2 ? keep - 2 : 0), _spare(nullptr), _retired(nullptr), _nextSegment(0), _dropped(0), _shouldStop(false) {
+			_run = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			std::vector<std::string> files = sessionLogFiles(base);
+			_base = base + "." + _runName(base, _run, files);
+			// Earlier runs count towards keep, and go first. Run names sort in time order.
+			for(auto& path : files) {
+				_closed.push_back(path);
+			}
+			_prune();
+			_current = _open();
+			_thread = std::thread(std::bind(&SessionRecorder::_loop, this));
+		}
+
+		~SessionRecorder() {
+			_shouldStop.store(true);
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_cv.notify_all();
+			}
+			_thread.join();
+			Segment* s = _retired.exchange(nullptr);
+			if(s != nullptr) {
+				_close(s);
+			}
+			if(_current != nullptr) {
+				_close(_current);
+			}
+			s = _spare.exchange(nullptr);
+			if(s != nullptr) {
+				std::string path = s->path;
+				delete s;
+				std::remove(path.c_str());
+			}
+		}
+
+		bool isRecording() const { return _current != nullptr; }
+		long dropped() const { return _dropped.load(); }
+
+		void record(int type, const ci::tuio::Cursor& c) {
+			record(type, c.getSessionId(), -1, c.getPos(), 0.0f, c.getSpeed());
+		}
+
+		void record(int type, const ci::tuio::Object& o) {
+			record(type, o.getSessionId(), o.getFiducialId(), o.getPos(), o.getAngle(), o.getSpeed());
+		}
+
+		void record(int type, int sessionId, int fiducialId, const ci::Vec2f& position, float angle, const ci::Vec2f& speed) {
+			if(_current == nullptr || _current->header->count == _capacity) {
+				Segment* next = _spare.exchange(nullptr);
+				if(next == nullptr) {
+					_dropped++;
+					return;
+				}
+				if(_current != nullptr) {
+					_retired.store(_current);
+				}
+				_current = next;
+				_cv.notify_one();
+			}
+			TuioEvent& e = _current->records[_current->header->count];
+			e.time = elapsedSeconds();
+			e.type = type;
+			e.sessionId = sessionId;
+			e.fiducialId = fiducialId;
+			e.x = position.x;
+			e.y = position.y;
+			e.angle = angle;
+			e.xSpeed = speed.x;
+			e.ySpeed = speed.y;
+			// The record is complete before anyone can see it counted
+			std::atomic_thread_fence(std::memory_order_release);
+			_current->header->count = _current->header->count + 1;
+		}
+	};
+
+	// Read-only, zero-copy view of one segment of a session log, mapped as it is on
+	// disk. A segment that is still being written shows the records written when it was opened.
+	class SessionReader {
+		MappedFile _file;
+		const SessionLogHeader* _header;
+		const TuioEvent* _records;
+		size_t _count;
+
+	public:
+		SessionReader() : _header(nullptr), _records(nullptr), _count(0) { }
+
+		// Fails if path isn't a session log, or a log written with a different record layout.
+		bool open(const std::string& path) {
+			_header = nullptr;
+			_records = nullptr;
+			_count = 0;
+			if(!_file.open(path) || _file.size() < sizeof(SessionLogHeader)) {
+				_file.close();
+				return false;
+			}
+			const SessionLogHeader* h = (const SessionLogHeader*)_file.data();
+			if(memcmp(h->magic, SESSION_LOG_MAGIC, sizeof(h->magic)) != 0 || h->recordSize != sizeof(TuioEvent)) {
+				_file.close();
+				return false;
+			}
+			size_t fits = (_file.size() - sizeof(SessionLogHeader)) / sizeof(TuioEvent);
+			_header = h;
+			_records = (const TuioEvent*)(_file.data() + sizeof(SessionLogHeader));
+			_count = std::min((size_t)h->count, fits);
+			return true;
+		}
+
+		uint64_t segment() const { return _header->segment; }
+		uint64_t run() const { return _header->run; }
+		size_t size() const { return _count; }
+		const TuioEvent& operator[](size_t i) const { return _records[i]; }
+		const TuioEvent* begin() const { return _records; }
+		const TuioEvent* end() const { return _records + _count; }
+	};
+
+}
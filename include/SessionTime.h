@@ -0,0 +1,36 @@
+#pragma once
+
+#if defined(SECONDSTUDY_HEADLESS)
+#include <atomic>
+#include <chrono>
+#else
+#include "cinder/app/AppNative.h"
+#endif
+
+namespace SecondStudy {
+
+#if defined(SECONDSTUDY_HEADLESS)
+	// Headless there is no app clock: time is whatever the replay says it is, so tap
+	// lengths and removal timeouts come out the same at any replay speed.
+	inline std::atomic<double>& replayTime() {
+		static std::atomic<double> t(0.0);
+		return t;
+	}
+
+	inline double elapsedSeconds() { return replayTime().load(); }
+
+	// A std::chrono clock that reads replay time, for what would run on steady_clock live.
+	struct ReplayClock {
+		typedef std::chrono::nanoseconds duration;
+		typedef duration::rep rep;
+		typedef duration::period period;
+		typedef std::chrono::time_point<ReplayClock> time_point;
+		static const bool is_steady = true;
+
+		static time_point now() { return time_point(std::chrono::duration_cast<duration>(std::chrono::duration<double>(replayTime().load()))); }
+	};
+#else
+	inline double elapsedSeconds() { return ci::app::getElapsedSeconds(); }
+#endif
+
+}
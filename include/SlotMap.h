@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+namespace SecondStudy {
+
+	// Values keyed by a TUIO ID (session or fiducial), stored densely: iterating goes
+	// through one contiguous array of (ID, value) pairs, like a map's but in no particular
+	// order, and looking an ID up is one hash lookup. Every value also gets a generational
+	// handle, which finds it without the lookup and stops finding anything once it's
+	// erased, even if its slot is reused later, so it can be kept around (e.g. in
+	// Deadlines) and checked for free. Erasing moves the last value into the gap, so
+	// iterators and pointers into the map don't survive it, handles do.
+	template<typename T>
+	class SlotMap {
+	public:
+		typedef std::pair<int, T> Entry;
+		typedef typename std::vector<Entry>::iterator iterator;
+		typedef typename std::vector<Entry>::const_iterator const_iterator;
+
+		struct Handle {
+			uint32_t slot;
+			uint32_t generation; // 0 for no value at all
+
+			Handle() : slot(0), generation(0) { }
+			Handle(uint32_t s, uint32_t g) : slot(s), generation(g) { }
+
+			bool operator==(const Handle& o) const { return slot == o.slot && generation == o.generation; }
+			bool operator<(const Handle& o) const { return slot < o.slot || (slot == o.slot && generation < o.generation); }
+		};
+
+	private:
+		static const uint32_t FREE = 0xffffffff;
+
+		struct Slot {
+			uint32_t entry; // where its value is in _entries, FREE if it has none
+			uint32_t generation; // goes up every time the slot is freed
+
+			Slot() : entry(FREE), generation(1) { }
+		};
+
+		std::vector<Entry> _entries;
+		std::vector<uint32_t> _slotOf; // the slot of each entry
+		std::vector<Slot> _slots;
+		std::vector<uint32_t> _free;
+		std::unordered_map<int, uint32_t> _slotById;
+
+		bool _valid(Handle h) const {
+			return h.slot < _slots.size() && _slots[h.slot].generation == h.generation && _slots[h.slot].entry != FREE;
+		}
+
+	public:
+		// Adds value under id, which must not be in the map already.
+		Handle insert(int id, const T& value) {
+			uint32_t s;
+			if(_free.empty()) {
+				s = (uint32_t)_slots.size();
+				_slots.push_back(Slot());
+			} else {
+				s = _free.back();
+				_free.pop_back();
+			}
+			_slots[s].entry = (uint32_t)_entries.size();
+			_entries.push_back(Entry(id, value));
+			_slotOf.push_back(s);
+			_slotById[id] = s;
+			return Handle(s, _slots[s].generation);
+		}
+
+		// The handle of id, one that finds nothing if it isn't in the map
+		Handle handle(int id) const {
+			auto it = _slotById.find(id);
+			return it == _slotById.end() ? Handle() : Handle(it->second, _slots[it->second].generation);
+		}
+
+		// The value of a handle, nullptr if it's been erased
+		T* get(Handle h) { return _valid(h) ? &_entries[_slots[h.slot].entry].second : nullptr; }
+		const T* get(Handle h) const { return _valid(h) ? &_entries[_slots[h.slot].entry].second : nullptr; }
+
+		iterator find(int id) {
+			auto it = _slotById.find(id);
+			return it == _slotById.end() ? _entries.end() : _entries.begin() + _slots[it->second].entry;
+		}
+		const_iterator find(int id) const {
+			auto it = _slotById.find(id);
+			return it == _slotById.end() ? _entries.end() : _entries.begin() + _slots[it->second].entry;
+		}
+
+		// Throws std::out_of_range if id isn't in the map, as map::at() does
+		T& at(int id) { return _entries[_slots[_slotById.at(id)].entry].second; }
+		const T& at(int id) const { return _entries[_slots[_slotById.at(id)].entry].second; }
+
+		void erase(Handle h) {
+			if(!_valid(h)) {
+				return;
+			}
+			uint32_t e = _slots[h.slot].entry;
+			uint32_t last = (uint32_t)_entries.size() - 1;
+			_slotById.erase(_entries[e].first);
+			if(e != last) {
+				_entries[e] = std::move(_entries[last]);
+				_slotOf[e] = _slotOf[last];
+				_slots[_slotOf[e]].entry = e;
+			}
+			_entries.pop_back();
+			_slotOf.pop_back();
+			_slots[h.slot].entry = FREE;
+			_slots[h.slot].generation++;
+			_free.push_back(h.slot);
+		}
+
+		iterator begin() { return _entries.begin(); }
+		iterator end() { return _entries.end(); }
+		const_iterator begin() const { return _entries.begin(); }
+		const_iterator end() const { return _entries.end(); }
+		size_t size() const { return _entries.size(); }
+		bool empty() const { return _entries.empty(); }
+	};
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <memory>
+
+namespace SecondStudy {
+
+	// Read-copy-update for state that is read far more often than it changes.
+	// Writers build a new immutable T (serialising among themselves however they like)
+	// and publish() it with one atomic pointer swap. Readers load() the current one
+	// without taking any lock and keep it for as long as they need it: the old T is only
+	// freed once the last reader holding it lets go, so it never changes under them.
+	// That is only as deep as copying T goes: if T holds pointers, a snapshot fixes which
+	// objects there are, not what is in them, and those need rules of their own.
+	template<typename T>
+	class Snapshot {
+		std::shared_ptr<const T> _current;
+
+	public:
+		Snapshot() : _current(std::make_shared<T>()) { }
+
+		std::shared_ptr<const T> load() const { return std::atomic_load(&_current); }
+
+		void publish(std::shared_ptr<const T> t) { std::atomic_store(&_current, t); }
+		void publish(const T& t) { publish(std::make_shared<const T>(t)); }
+	};
+
+}
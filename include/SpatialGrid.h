@@ -0,0 +1,143 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
+#include "cinder/Vector.h"
+
+namespace SecondStudy {
+
+	// Uniform grid of circles keyed by an integer ID (the fiducial ID, for tangibles).
+	// Every entry is stored in each cell its bounding box overlaps, so a point query
+	// only has to look at the handful of entries sharing that point's cell, and a
+	// radius query only at the cells the search circle overlaps.
+	class SpatialGrid {
+		struct Entry {
+			ci::Vec2f position;
+			float radius;
+			int x0, y0, x1, y1;
+			unsigned int stamp; // last query that visited this entry
+		};
+
+		int _cols, _rows;
+		float _cellSize;
+		std::vector<std::vector<int>> _cells;
+		std::map<int, Entry> _entries;
+		unsigned int _stamp;
+		std::mutex _mutex;
+
+		int _cellX(float x) const { return std::min(std::max((int)(x / _cellSize), 0), _cols - 1); }
+		int _cellY(float y) const { return std::min(std::max((int)(y / _cellSize), 0), _rows - 1); }
+
+		void _unlink(int id, const Entry& e) {
+			for(int y = e.y0; y <= e.y1; y++) {
+				for(int x = e.x0; x <= e.x1; x++) {
+					std::vector<int>& cell = _cells[y * _cols + x];
+					cell.erase(std::remove(cell.begin(), cell.end(), id), cell.end());
+				}
+			}
+		}
+
+		void _link(int id, const Entry& e) {
+			for(int y = e.y0; y <= e.y1; y++) {
+				for(int x = e.x0; x <= e.x1; x++) {
+					_cells[y * _cols + x].push_back(id);
+				}
+			}
+		}
+
+	public:
+		SpatialGrid(ci::Vec2f size, float cellSize) : _cellSize(cellSize), _stamp(0) {
+			_cols = std::max(1, (int)ceil(size.x / cellSize));
+			_rows = std::max(1, (int)ceil(size.y / cellSize));
+			_cells.resize(_cols * _rows);
+		}
+
+		void insert(int id, ci::Vec2f position, float radius) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			Entry e;
+			e.position = position;
+			e.radius = radius;
+			e.x0 = _cellX(position.x - radius);
+			e.y0 = _cellY(position.y - radius);
+			e.x1 = _cellX(position.x + radius);
+			e.y1 = _cellY(position.y + radius);
+			e.stamp = 0;
+
+			auto it = _entries.find(id);
+			if(it != _entries.end()) {
+				Entry& old = it->second;
+				if(old.x0 != e.x0 || old.y0 != e.y0 || old.x1 != e.x1 || old.y1 != e.y1) {
+					_unlink(id, old);
+					_link(id, e);
+				}
+				e.stamp = old.stamp;
+				old = e;
+			} else {
+				_link(id, e);
+				_entries[id] = e;
+			}
+		}
+
+		void remove(int id) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto it = _entries.find(id);
+			if(it != _entries.end()) {
+				_unlink(id, it->second);
+				_entries.erase(it);
+			}
+		}
+
+		// IDs of all the entries whose circle contains p.
+		std::vector<int> query(ci::Vec2f p) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			std::vector<int> result;
+			for(int id : _cells[_cellY(p.y) * _cols + _cellX(p.x)]) {
+				const Entry& e = _entries[id];
+				if(e.position.distance(p) <= e.radius) {
+					result.push_back(id);
+				}
+			}
+			return result;
+		}
+
+		// IDs of the entries whose centre lies within radius of p, closest first.
+		// At most k are returned (0 means all of them), and exclude is never returned,
+		// which is handy when p is itself the position of an entry.
+		std::vector<int> nearest(ci::Vec2f p, float radius, size_t k = 0, int exclude = -1) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			// Entries span several cells, stamp them so each is only considered once.
+			_stamp++;
+			std::vector<std::pair<float, int>> found;
+			int x0 = _cellX(p.x - radius), x1 = _cellX(p.x + radius);
+			int y0 = _cellY(p.y - radius), y1 = _cellY(p.y + radius);
+			for(int y = y0; y <= y1; y++) {
+				for(int x = x0; x <= x1; x++) {
+					for(int id : _cells[y * _cols + x]) {
+						Entry& e = _entries[id];
+						if(id == exclude || e.stamp == _stamp) {
+							continue;
+						}
+						e.stamp = _stamp;
+						float d = e.position.distance(p);
+						if(d <= radius) {
+							found.push_back(std::make_pair(d, id));
+						}
+					}
+				}
+			}
+			if(k == 0 || k > found.size()) {
+				k = found.size();
+			}
+			std::partial_sort(found.begin(), found.begin() + k, found.end());
+			std::vector<int> result;
+			for(size_t i = 0; i < k; i++) {
+				result.push_back(found[i].second);
+			}
+			return result;
+		}
+	};
+
+}
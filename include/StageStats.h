@@ -0,0 +1,104 @@
+#pragma once
+
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <ostream>
+#include <iomanip>
+
+#define STAGE_STATS_BUCKETS 24 // powers of two of microseconds, the last one takes anything from 8 s up
+
+namespace SecondStudy {
+
+	// How long a stage of the pipeline takes: count, mean, max and a histogram with one
+	// bucket per power of two of microseconds, for percentiles.
+	// Each instance must only be written by one thread, which keeps it as cheap as a
+	// thread local: add() is a handful of relaxed loads and stores, no read-modify-write.
+	// Any thread may read it at any time, and gets figures that are at most one add() behind.
+	class StageStats {
+	public:
+		typedef std::chrono::steady_clock Clock;
+
+	private:
+		std::atomic<long> _count;
+		std::atomic<long long> _total; // ns
+		std::atomic<long long> _max; // ns
+		std::atomic<long> _buckets[STAGE_STATS_BUCKETS];
+
+		StageStats(const StageStats&);
+		StageStats& operator=(const StageStats&);
+
+		template<typename T>
+		static void _bump(std::atomic<T>& a, T by) {
+			a.store(a.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+		}
+
+	public:
+		StageStats() : _count(0), _total(0), _max(0) {
+			for(auto& b : _buckets) {
+				b.store(0, std::memory_order_relaxed);
+			}
+		}
+
+		void add(Clock::duration d) {
+			long long ns = std::max((long long)std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(), 0LL);
+			int bucket = 0;
+			for(long long us = ns / 1000; us > 1 && bucket < STAGE_STATS_BUCKETS - 1; us >>= 1) {
+				bucket++;
+			}
+			_bump(_buckets[bucket], 1L);
+			_bump(_total, ns);
+			if(ns > _max.load(std::memory_order_relaxed)) {
+				_max.store(ns, std::memory_order_relaxed);
+			}
+			_bump(_count, 1L);
+		}
+
+		long count() const { return _count.load(std::memory_order_relaxed); }
+		double mean() const {
+			long n = count();
+			return n > 0 ? _total.load(std::memory_order_relaxed) / 1000.0 / n : 0.0;
+		}
+		double max() const { return _max.load(std::memory_order_relaxed) / 1000.0; }
+
+		// Upper bound, in microseconds, of the bucket the q-th quantile (0 to 1) falls in.
+		double percentile(double q) const {
+			long counts[STAGE_STATS_BUCKETS];
+			long n = 0;
+			for(int i = 0; i < STAGE_STATS_BUCKETS; i++) {
+				counts[i] = _buckets[i].load(std::memory_order_relaxed);
+				n += counts[i];
+			}
+			long rank = (long)(q * n);
+			for(int i = 0; i < STAGE_STATS_BUCKETS; i++) {
+				if(rank < counts[i]) {
+					return std::min((double)(2L << i), max());
+				}
+				rank -= counts[i];
+			}
+			return max();
+		}
+
+		// One line of a table of stages, see header().
+		void print(std::ostream& out, const char* name) const {
+			out << std::left << std::setw(16) << name << std::right << std::setw(10) << count()
+				<< std::setw(14) << mean() << std::setw(14) << percentile(0.5) << std::setw(14) << percentile(0.99) << std::setw(14) << max() << std::endl;
+		}
+
+		static void header(std::ostream& out) {
+			out << std::left << std::setw(16) << "stage" << std::right << std::setw(10) << "count"
+				<< std::setw(14) << "mean (us)" << std::setw(14) << "p50 (us)" << std::setw(14) << "p99 (us)" << std::setw(14) << "max (us)" << std::endl;
+		}
+
+		// Times whatever happens until it goes out of scope.
+		class Scope {
+			StageStats& _stats;
+			Clock::time_point _start;
+
+		public:
+			Scope(StageStats& stats) : _stats(stats), _start(Clock::now()) { }
+			~Scope() { _stats.add(Clock::now() - _start); }
+		};
+	};
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "StageStats.h"
+
+namespace SecondStudy {
+
+	// Every so often, writes the figures of a set of stages, and of gauges such as queue
+	// depths, to a text file that anything can read whenever it likes: the file is
+	// always replaced whole, never seen half written. The writing happens on a thread
+	// of its own, the stages are just read where they are (see StageStats).
+	class StatsFile {
+		std::string _path;
+		std::chrono::milliseconds _period;
+		std::vector<std::pair<std::string, const StageStats*>> _stages;
+		std::vector<std::pair<std::string, std::function<double()>>> _gauges;
+
+		std::thread _thread;
+		std::mutex _mutex;
+		std::condition_variable _cv;
+		bool _shouldStop;
+
+		void _write() {
+			std::string tmp = _path + ".tmp";
+			{
+				std::ofstream out(tmp.c_str());
+				if(!out) {
+					return;
+				}
+				out << std::fixed << std::setprecision(3);
+				StageStats::header(out);
+				for(auto& s : _stages) {
+					s.second->print(out, s.first.c_str());
+				}
+				out << std::endl;
+				for(auto& g : _gauges) {
+					out << std::left << std::setw(30) << g.first << std::right << std::setw(14) << g.second() << std::endl;
+				}
+			}
+#if defined(_WIN32)
+			// rename() won't replace a file on Windows
+			std::remove(_path.c_str());
+#endif
+			std::rename(tmp.c_str(), _path.c_str());
+		}
+
+		void _loop() {
+			std::unique_lock<std::mutex> lock(_mutex);
+			while(!_shouldStop) {
+				_cv.wait_for(lock, _period);
+				_write();
+			}
+		}
+
+	public:
+		StatsFile(const std::string& path, std::chrono::milliseconds period) : _path(path), _period(period), _shouldStop(false) { }
+
+		~StatsFile() { stop(); }
+
+		// Only before start()
+		void add(const std::string& name, const StageStats& stats) { _stages.push_back(std::make_pair(name, &stats)); }
+		void gauge(const std::string& name, std::function<double()> value) { _gauges.push_back(std::make_pair(name, value)); }
+
+		void start() {
+			_thread = std::thread(std::bind(&StatsFile::_loop, this));
+		}
+
+		// Writes the file one last time
+		void stop() {
+			if(!_thread.joinable()) {
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_shouldStop = true;
+				_cv.notify_all();
+			}
+			_thread.join();
+		}
+	};
+
+}
@@ -1,18 +1,18 @@
 #pragma once
 
+#include <memory>
 #include "cinder/Vector.h"
 #include "TouchTrace.h"
-#include "Gesture.h"
 
 namespace SecondStudy {
 	
-	class StrokeGesture : public Gesture {
+	// Payload of a Gesture::STROKE
+	class StrokeGesture {
 	public:
-		TouchTrace trace;
+		// The finished trace itself, its points stay in the arena until the gesture is done with
+		std::shared_ptr<TouchTrace> trace;
 		
 		StrokeGesture() { }
-		StrokeGesture(shared_ptr<TouchTrace> t) : trace(*t) { }
-		
-		~StrokeGesture() { }
+		StrokeGesture(std::shared_ptr<TouchTrace> t) : trace(t) { }
 	};
 }
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "cinder/Vector.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define STROKE_KERNEL_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace SecondStudy {
+
+	// Takes a stroke onto a board: an affine transform, then samples at even steps
+	// along its length, quantised to the cells of the board.
+	// The points are kept as structure of arrays in buffers that only ever grow, so
+	// once a stroke this long has been seen nothing is allocated. The transform works
+	// out the length of every segment in the same pass, four points at a time where
+	// SSE is available.
+	class StrokeKernel {
+		std::vector<float> _x, _y;
+		std::vector<float> _length; // from each point to the next
+		size_t _n;
+		float _total;
+
+	public:
+		StrokeKernel() : _n(0), _total(0.0f) { }
+
+		void clear() {
+			_n = 0;
+			_total = 0.0f;
+		}
+
+		// Adds points to the end of the stroke, e.g. each run of a smoothed trace.
+		void append(const ci::Vec2f* points, size_t n) {
+			if(_x.size() < _n + n) {
+				_x.resize(_n + n);
+				_y.resize(_n + n);
+				_length.resize(_n + n);
+			}
+			for(size_t i = 0; i < n; i++) {
+				_x[_n + i] = points[i].x;
+				_y[_n + i] = points[i].y;
+			}
+			_n += n;
+		}
+
+		size_t size() const { return _n; }
+		float length() const { return _total; }
+
+		// In place: x' = m[0] x + m[1] y + m[2], y' = m[3] x + m[4] y + m[5].
+		void transform(const float m[6]) {
+			size_t i = 0;
+			float total = 0.0f;
+#if defined(STROKE_KERNEL_SSE)
+			const __m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]), m2 = _mm_set1_ps(m[2]);
+			const __m128 m3 = _mm_set1_ps(m[3]), m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]);
+			__m128 sum = _mm_setzero_ps();
+			// Each block also needs the point after it, still untransformed, for its last length
+			for(; i + 4 < _n; i += 4) {
+				__m128 x = _mm_loadu_ps(&_x[i]), y = _mm_loadu_ps(&_y[i]);
+				__m128 nx = _mm_loadu_ps(&_x[i + 1]), ny = _mm_loadu_ps(&_y[i + 1]);
+				__m128 tx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, x), _mm_mul_ps(m1, y)), m2);
+				__m128 ty = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m3, x), _mm_mul_ps(m4, y)), m5);
+				__m128 dx = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, nx), _mm_mul_ps(m1, ny)), m2), tx);
+				__m128 dy = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m3, nx), _mm_mul_ps(m4, ny)), m5), ty);
+				__m128 l = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+				_mm_storeu_ps(&_x[i], tx);
+				_mm_storeu_ps(&_y[i], ty);
+				_mm_storeu_ps(&_length[i], l);
+				sum = _mm_add_ps(sum, l);
+			}
+			float lanes[4];
+			_mm_storeu_ps(lanes, sum);
+			total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+			for(; i < _n; i++) {
+				float tx = m[0] * _x[i] + m[1] * _y[i] + m[2];
+				float ty = m[3] * _x[i] + m[4] * _y[i] + m[5];
+				_length[i] = 0.0f;
+				if(i + 1 < _n) {
+					float dx = m[0] * _x[i + 1] + m[1] * _y[i + 1] + m[2] - tx;
+					float dy = m[3] * _x[i + 1] + m[4] * _y[i + 1] + m[5] - ty;
+					_length[i] = sqrt(dx * dx + dy * dy);
+					total += _length[i];
+				}
+				_x[i] = tx;
+				_y[i] = ty;
+			}
+			_total = total;
+		}
+
+		// Samples the transformed stroke every step along its length, starting with the
+		// first point and ending with the last one, divided by size so that a board spans
+		// -0.5 to 0.5. The samples go into out, which is cleared first so its capacity is
+		// reused. Then each sample is quantised to the cells of a board with notes.size()
+		// columns and rows rows: notes[column] becomes the lowest row any sample of that
+		// column falls in, if that's lower than what it was.
+		void resample(float step, ci::Vec2f size, int rows, std::vector<ci::Vec2f>& out, std::vector<int>& notes) const {
+			out.clear();
+			if(_n == 0) {
+				return;
+			}
+			size_t i = 0;
+			float at = 0.0f; // how far along point i is
+			for(float s = 0.0f; s <= _total; s += step) {
+				while(i + 1 < _n && at + _length[i] < s) {
+					at += _length[i];
+					i++;
+				}
+				if(i + 1 < _n && _length[i] > 0.0f) {
+					float u = (s - at) / _length[i];
+					out.push_back(ci::Vec2f((_x[i] + (_x[i + 1] - _x[i]) * u) / size.x, (_y[i] + (_y[i + 1] - _y[i]) * u) / size.y));
+				} else {
+					out.push_back(ci::Vec2f(_x[i] / size.x, _y[i] / size.y));
+				}
+				if(step <= 0.0f) {
+					break;
+				}
+			}
+			out.push_back(ci::Vec2f(_x[_n - 1] / size.x, _y[_n - 1] / size.y));
+
+			int columns = (int)notes.size();
+			for(const ci::Vec2f& p : out) {
+				// Truncated the way a Vec2i would be, so up to a column's width left of the board is still column 0
+				int column = (int)(columns * (p.x + 0.5f));
+				int row = (int)(rows * (p.y + 0.5f));
+				if(column > -1 && column < columns) {
+					notes[column] = std::min(notes[column], row);
+				}
+			}
+		}
+	};
+
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "cinder/Vector.h"
+#include "TouchTrace.h"
+#include "Tangible.h"
+#include "SequenceStore.h"
+#include "SlotMap.h"
+#include "PoseFrame.h"
+
+namespace SecondStudy {
+
+	// Everything about a finished stroke the recognizers share, worked out once.
+	struct StrokeContext {
+		std::shared_ptr<TouchTrace> trace;
+		std::shared_ptr<const SlotMap<std::shared_ptr<Tangible>>> objects;
+		std::shared_ptr<const PoseFrame> poses; // where the visible ones are, use these
+		std::shared_ptr<const SequenceStore> sequences;
+		ci::Vec2f front, back; // ends of the stroke, on the screen
+		std::vector<int> underFront, underBack; // tangibles within reach of either end, nearest first
+		std::vector<ci::Vec2f> path; // the whole stroke, smoothed, in table space
+	};
+
+	// What a recognizer found. score is 0 if the stroke isn't one of its kind, otherwise
+	// the highest score wins. a and b say what it applies to, e.g. a tangible or a link.
+	struct StrokeMatch {
+		float score;
+		int a, b;
+
+		StrokeMatch() : score(0.0f), a(-1), b(-1) { }
+		StrokeMatch(float s, int a, int b) : score(s), a(a), b(b) { }
+	};
+
+	// Recognizes strokes with a set of independent recognizers, one per kind of stroke.
+	// Each one is a pair of callbacks: match() looks at the context and must not change
+	// anything, since they all run at the same time on a small pool of threads (and the
+	// calling one); commit() then runs on the calling thread, for the best match only.
+	// Ties go to the recognizer added first.
+	class StrokePipeline {
+	public:
+		typedef std::function<StrokeMatch(const StrokeContext&)> Match;
+		typedef std::function<void(const StrokeContext&, const StrokeMatch&)> Commit;
+
+	private:
+		struct Recognizer {
+			std::string name;
+			Match match;
+			Commit commit;
+			StrokeMatch result;
+		};
+
+		std::vector<Recognizer> _recognizers;
+		std::vector<std::thread> _workers;
+		std::mutex _mutex;
+		std::condition_variable _start;
+		std::condition_variable _done;
+		const StrokeContext* _context;
+		size_t _next; // next recognizer to be run on the current stroke
+		size_t _pending; // recognizers of the current stroke not done yet
+		unsigned long _generation; // strokes so far, tells the workers there is a new one
+		bool _shouldStop;
+
+		// Runs recognizers of the current stroke until none are left to start. With _mutex held.
+		void _evaluate(std::unique_lock<std::mutex>& lock) {
+			while(_next < _recognizers.size()) {
+				Recognizer& r = _recognizers[_next++];
+				lock.unlock();
+				StrokeMatch m = r.match(*_context);
+				lock.lock();
+				r.result = m;
+				if(--_pending == 0) {
+					_done.notify_all();
+				}
+			}
+		}
+
+		void _loop() {
+			std::unique_lock<std::mutex> lock(_mutex);
+			unsigned long seen = _generation;
+			while(true) {
+				_start.wait(lock, [&] { return _shouldStop || _generation != seen; });
+				if(_shouldStop) {
+					return;
+				}
+				seen = _generation;
+				_evaluate(lock);
+			}
+		}
+
+	public:
+		// threads on top of the calling one, 0 runs every recognizer on the calling thread.
+		StrokePipeline(size_t threads) : _context(nullptr), _next(0), _pending(0), _generation(0), _shouldStop(false) {
+			for(size_t i = 0; i < threads; i++) {
+				_workers.push_back(std::thread(std::bind(&StrokePipeline::_loop, this)));
+			}
+		}
+
+		~StrokePipeline() {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_shouldStop = true;
+				_start.notify_all();
+			}
+			for(auto& w : _workers) {
+				w.join();
+			}
+		}
+
+		// Not while run() is
+		void add(const std::string& name, Match match, Commit commit) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			Recognizer r;
+			r.name = name;
+			r.match = match;
+			r.commit = commit;
+			_recognizers.push_back(r);
+		}
+
+		// Commits the best match for the stroke and returns the name of its recognizer,
+		// or nullptr if none of them recognized it. One stroke at a time.
+		const char* run(const StrokeContext& context) {
+			std::unique_lock<std::mutex> lock(_mutex);
+			_context = &context;
+			_next = 0;
+			_pending = _recognizers.size();
+			_generation++;
+			_start.notify_all();
+			_evaluate(lock);
+			_done.wait(lock, [&] { return _pending == 0; });
+			_context = nullptr;
+
+			Recognizer* best = nullptr;
+			for(auto& r : _recognizers) {
+				if(r.result.score > 0.0f && (best == nullptr || r.result.score > best->result.score)) {
+					best = &r;
+				}
+			}
+			lock.unlock();
+
+			if(best == nullptr) {
+				return nullptr;
+			}
+			best->commit(context, best->result);
+			return best->name.c_str();
+		}
+	};
+
+}
@@ -1,10 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
+#include <list>
+#include <vector>
+#include <cmath>
 #include "TuioObject.h"
-#include "cinder/app/AppNative.h"
-#include "cinder/Timeline.h"
-#include "OscSender.h"
-#include "OscMessage.h"
+#include "NoteGrid.h"
+#include "SessionTime.h"
+#include "cinder/Rect.h"
 
 using namespace ci;
 using namespace std;
@@ -13,25 +17,35 @@ namespace SecondStudy {
 
     class Tangible : public std::enable_shared_from_this<Tangible> {
 	pair<int, int> _size;
-	vector<int> _midiNotes;
-	CueRef _cue;
-	shared_ptr<osc::Sender> _sender;
-	TimelineRef _timeline;
-
-	void _play(int currentNote) {
-		for(int i = 0; i < _size.second; i++) {
-			if(notes[currentNote][i]) {
-				osc::Message m;
-				m.setAddress("/playnote");
-				m.addIntArg(_midiNotes[i]);
-				_sender->sendMessage(m);
-			}
-		}
-	}	
 
 public:
+	// 8 notes, 5 pitches
+	typedef NoteGrid<8, 5> Notes;
+
+	// Where a tangible was as of one TUIO frame, by value, so it can be published for
+	// the other threads to hit-test against, see pose().
+	struct Pose {
+		Vec2f position; // TUIO space
+		float angle;
+		float cos;
+		float sin;
+
+		Pose() : angle(0.0f), cos(1.0f), sin(0.0f) { }
+
+		// Maps a screen point into the unscaled frame the board and icons are defined in.
+		// s, o and scale are the same TUIO-to-screen scale, offset and zoom used to draw it.
+		Vec2f toLocal(Vec2f p, const Vec2f& s, const Vec2f& o, float scale) const {
+			p -= position * s + o;
+			return Vec2f(p.x * cos + p.y * sin, p.y * cos - p.x * sin) / scale;
+		}
+	};
+
+	// Shared between threads as is. The pose (object, isVisible, timeRemoved and the
+	// frame below) is only written, and only read, by the main thread: the others get
+	// copies of it, see pose(). isOn is written by the gesture thread, and the rects
+	// never change.
 	tuio::Object object;
-	bool isOn;
+	atomic<bool> isOn;
 	bool isVisible;
 	double timeRemoved;
 	Rectf icon;
@@ -39,22 +53,28 @@ public:
 	Rectf closeIcon;
 	Rectf playIcon;
 	Rectf cursor;
-	Anim<Vec2f> cursorOffset;
+	// Column the scheduler is playing, -1 when it isn't playing this one.
+	atomic<int> playhead;
+
+	// Local frame of the board, cached by updateFrame() so hit-testing
+	// doesn't need to build and invert a matrix for every tangible.
+	Vec2f framePosition;
+	float frameAngle;
+	float frameCos;
+	float frameSin;
 	
-	list<list<Vec2f>> strokes;
+	list<vector<Vec2f>> strokes;
 	mutex strokesMutex;
 
-	vector<vector<bool>> notes;
+	Notes notes;
 	mutex notesMutex;
 
 	Tangible(void) {
-		_timeline = Timeline::create();
-		_size = pair<int, int>(8,5); // 8 notes, 5 pitches
-		notes = vector<vector<bool>>(_size.first, vector<bool>(_size.second, false));
+		_size = pair<int, int>(Notes::columns(), Notes::pitches());
 
 		isOn = false;
 		isVisible = true;
-		timeRemoved = app::getElapsedSeconds();
+		timeRemoved = elapsedSeconds();
 
 		icon = Rectf(Vec2f(30.0f, -15.0f), Vec2f(60.0f, 15.0f));
 		board = Rectf(Vec2f(30.0f, -50.0f), Vec2f(190.0f, 50.0f));
@@ -62,14 +82,18 @@ public:
 		playIcon = Rectf(Vec2f(200.0f, -20.0f), Vec2f(220.0f, 0.0f));
 		cursor = Rectf(Vec2f(30.0f, 50.0f), Vec2f(30.0f + (board.getWidth() / _size.first), 55.0f));
 
-		_sender = nullptr;
+		frameAngle = 0.0f;
+		frameCos = 1.0f;
+		frameSin = 0.0f;
+
+		playhead = -1;
 
 		// C major pentatonic
-		_midiNotes.push_back(69);
-		_midiNotes.push_back(67);
-		_midiNotes.push_back(64);
-		_midiNotes.push_back(62);
-		_midiNotes.push_back(60);
+		notes.pitch(0, 69);
+		notes.pitch(1, 67);
+		notes.pitch(2, 64);
+		notes.pitch(3, 62);
+		notes.pitch(4, 60);
 	}
 
 	~Tangible(void) {
@@ -78,31 +102,53 @@ public:
 
 	void toggle(pair<int, int> note) {
 		if(note.first >= 0 && note.first < _size.first && note.second >= 0 && note.second < _size.second) {
-			if(notes[note.first][note.second]) {
-				notes[note.first][note.second] = false;
-			} else {
-                for(auto a : notes[note.first]) {
-                    a = false;
-                }
-				notes[note.first][note.second] = true;
-			}
+			lock_guard<mutex> lock(notesMutex);
+			notes.toggle(note.first, note.second);
 		}
 	}
 
 	pair<int, int>& size() { return _size; }
 
-	void sender(shared_ptr<osc::Sender> sender) { _sender = sender; }
+	// Refreshes the cached frame from object. Returns false if it didn't move.
+	bool updateFrame() {
+		Vec2f p = object.getPos();
+		float a = object.getAngle();
+		if(p == framePosition && a == frameAngle) {
+			return false;
+		}
+		framePosition = p;
+		frameAngle = a;
+		frameCos = cos(a);
+		frameSin = sin(a);
+		return true;
+	}
 
-	void play(float noteLength) {
-		app::timeline().apply(&cursorOffset, Vec2f(0.0f, 0.0f), 0);
-		app::timeline().appendTo(&cursorOffset, Vec2f(board.getWidth() * (1.0f - 1.0f/_size.first), 0.0f), noteLength*(_size.first));
-		app::timeline().appendTo(&cursorOffset, Vec2f(0.0f, 0.0f), noteLength, EaseInOutSine());
+	// The cached frame, by value. On the main thread only.
+	Pose pose() const {
+		Pose p;
+		p.position = framePosition;
+		p.angle = frameAngle;
+		p.cos = frameCos;
+		p.sin = frameSin;
+		return p;
+	}
 
-		for(int i = 0; i < _size.first; i++) {
-			_cue = app::timeline().add( bind(&Tangible::_play, this, i), app::timeline().getCurrentTime() + noteLength*i); 
+	// Radius of the circle enclosing everything drawn around the tangible, unscaled.
+	float boundingRadius() const {
+		if(!isOn) {
+			return 50.0f;
 		}
-		_cue->setAutoRemove(true);
-		_cue->setLoop(false);
+		Rectf r(board);
+		r.include(closeIcon);
+		r.include(playIcon);
+		r.include(cursor + Vec2f(board.getWidth(), 0.0f));
+		return max(max(r.getUpperLeft().length(), r.getUpperRight().length()), max(r.getLowerLeft().length(), r.getLowerRight().length()));
+	}
+
+	// Appends the MIDI notes to be played for the given column.
+	void column(int i, vector<int>& out) {
+		lock_guard<mutex> lock(notesMutex);
+		notes.append(i, out);
 	}
 };
 
@@ -1,11 +1,11 @@
 #pragma once
 
 #include "cinder/Vector.h"
-#include "Gesture.h"
 
 namespace SecondStudy {
 	
-	class TapGesture : public Gesture {
+	// Payload of a Gesture::TAP
+	class TapGesture {
 	public:
 		ci::Vec2f position;
 		
@@ -13,7 +13,5 @@ namespace SecondStudy {
 		TapGesture(ci::Vec2f p) : position(p) {
 			
 		}
-		
-		~TapGesture() { }
 	};
 }
\ No newline at end of file
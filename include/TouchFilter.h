@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include "cinder/Vector.h"
+
+#define TOUCH_FILTER_MIN_CUTOFF 1.0f // Hz, how hard a finger that's still is smoothed
+#define TOUCH_FILTER_BETA 10.0f // how much the cutoff goes up with speed, per TUIO unit per second
+#define TOUCH_FILTER_SPEED_CUTOFF 5.0f // Hz, for the speed TUIO reports, which is noisy too
+#define TOUCH_FILTER_TWO_PI 6.28318531f
+
+namespace SecondStudy {
+
+	// Smooths a finger as its positions come in, and says where it will be a moment later,
+	// so that what is drawn doesn't trail behind it. A 1 euro filter (Casiez et al.): a
+	// low-pass whose cutoff goes up with speed, so a finger that's still doesn't jitter and
+	// a fast one doesn't lag, fed the speed TUIO already works out rather than one of its
+	// own. A handful of floats per finger, no history.
+	class TouchFilter {
+		ci::Vec2f _position;
+		ci::Vec2f _speed;
+		float _lag; // s, how far behind the finger the filtered position is at the current cutoff
+		double _time;
+		bool _started;
+
+		// Time constant of a low-pass with this cutoff
+		static float _tau(float cutoff) { return 1.0f / (TOUCH_FILTER_TWO_PI * cutoff); }
+
+		// Weight of a new sample dt seconds after the last one, for this cutoff
+		static float _alpha(float cutoff, float dt) { return dt / (dt + _tau(cutoff)); }
+
+	public:
+		TouchFilter() : _lag(0.0f), _time(0.0), _started(false) { }
+
+		// A position and the speed TUIO gave with it, in TUIO units, at time t in seconds.
+		void add(ci::Vec2f position, ci::Vec2f speed, double t) {
+			if(!_started) {
+				_position = position;
+				_speed = speed;
+				_time = t;
+				_started = true;
+				return;
+			}
+			float dt = (float)std::max(t - _time, 0.0);
+			_time = t;
+			_speed += (speed - _speed) * _alpha(TOUCH_FILTER_SPEED_CUTOFF, dt);
+			float cutoff = TOUCH_FILTER_MIN_CUTOFF + TOUCH_FILTER_BETA * _speed.length();
+			_position += (position - _position) * _alpha(cutoff, dt);
+			_lag = _tau(cutoff);
+		}
+
+		ci::Vec2f position() const { return _position; }
+		ci::Vec2f speed() const { return _speed; }
+		double time() const { return _time; }
+
+		// Where the finger should be lead seconds after the last sample, going on as it was.
+		// Makes up for the lag of the filter as well.
+		ci::Vec2f predicted(float lead) const { return _position + _speed * (_lag + lead); }
+	};
+
+	// Checks the predictions of a TouchFilter against where the finger really went. One
+	// prediction at a time: when a later sample goes past the time it was made for, it's
+	// compared with the position interpolated there, and so is the raw position it was
+	// made from, which is what would be drawn otherwise.
+	class LeadCheck {
+		ci::Vec2f _predicted, _raw;
+		double _due;
+		bool _pending;
+		ci::Vec2f _last;
+		double _lastTime;
+
+	public:
+		LeadCheck() : _due(0.0), _pending(false), _lastTime(0.0) { }
+
+		// With every sample, after the filter has had it. Returns true if a prediction fell
+		// due, with how far off it was and how far off the raw position was.
+		bool sample(const TouchFilter& filter, ci::Vec2f position, double t, float lead, ci::Vec2f& predictedError, ci::Vec2f& rawError) {
+			bool due = _pending && t >= _due && t > _lastTime;
+			if(due) {
+				ci::Vec2f truth = _last + (position - _last) * (float)((_due - _lastTime) / (t - _lastTime));
+				predictedError = _predicted - truth;
+				rawError = _raw - truth;
+				_pending = false;
+			}
+			if(!_pending) {
+				_predicted = filter.predicted(lead);
+				_raw = position;
+				_due = t + lead;
+				_pending = true;
+			}
+			_last = position;
+			_lastTime = t;
+			return due;
+		}
+	};
+
+}
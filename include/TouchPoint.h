@@ -1,21 +1,19 @@
 #pragma once
 
-#include "TuioCursor.h"
-#include "cinder/app/AppNative.h"
+#include "cinder/Vector.h"
 
-class TouchPoint : public ci::tuio::Cursor {
+// One sample of a touch trace: where the finger was, how fast it was going and when.
+class TouchPoint {
 public:
+	ci::Vec2f position;
+	float speed;
 	double timestamp;
 	
-	TouchPoint(void) {
-		timestamp = ci::app::getElapsedSeconds();
+	TouchPoint(void) : speed(0.0f), timestamp(0.0) {
 	}
 	
-	TouchPoint(const ci::tuio::Cursor& c) : ci::tuio::Cursor(c) {
-		timestamp = ci::app::getElapsedSeconds();
+	TouchPoint(ci::Vec2f p, float s, double t) : position(p), speed(s), timestamp(t) {
 	}
 
-	~TouchPoint(void) {
-	}
+	const ci::Vec2f& getPos() const { return position; }
 };
-
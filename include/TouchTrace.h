@@ -1,12 +1,24 @@
 #pragma once
 
-#include <list>
-#include "TouchPoint.h"
+#include "TuioCursor.h"
+#include "TraceArena.h"
+#include "TouchFilter.h"
+#include "SessionTime.h"
 
 namespace SecondStudy {
 
 class TouchTrace {
-	int _lifespan;
+	TraceArena& _arena;
+	TraceArena::Slot* _slot;
+
+	TouchTrace(const TouchTrace&);
+	TouchTrace& operator=(const TouchTrace&);
+
+	void _append(const ci::tuio::Cursor& c) {
+		double t = elapsedSeconds();
+		TraceArena::append(_slot, TouchPoint(c.getPos(), c.getSpeed().length(), t));
+		filter.add(c.getPos(), c.getSpeed(), t);
+	}
 
 public:
 	enum class State {
@@ -16,42 +28,57 @@ public:
 		TOUCH_UP
 	} state;
 
-	std::list<TouchPoint> touchPoints;
-
 	bool isVisible;
 
-	TouchTrace(void) {
+	// What the trace looks like so far, kept up to date as points come in
+	int source; // tangible it started at, -1 if none
+	bool startsOnBoard; // on the board of a tangible that is on, so it may yet be a musical stroke
+	int crossedLink; // first link it crossed, by the tangible the link starts from, -1 if none
+	bool isCommitted; // already handed over as a gesture, nothing left to do once it finishes
+	int dwellTarget; // another tangible the finger is lingering by, -1 if none
+	double dwellSince; // session time it got there
+
+	// Where the finger is, smoothed and a little ahead, for drawing
+	TouchFilter filter;
+	LeadCheck leadCheck;
+
+	TouchTrace(TraceArena& arena, int sessionId) : _arena(arena) {
 		state = State::TOUCH_DOWN;
 		isVisible = true;
+		source = -1;
+		startsOnBoard = false;
+		crossedLink = -1;
+		isCommitted = false;
+		dwellTarget = -1;
+		dwellSince = 0.0;
 
-		_lifespan = 10;
+		_slot = _arena.acquire(sessionId);
 	}
 
 	~TouchTrace(void) {
-		touchPoints.clear();
+		_arena.release(_slot);
 	}
 
-	bool isDead() {
-		return (--_lifespan) == 0;
-	}
+	// The points so far, straight from the arena: nothing is copied.
+	TraceArena::View touchPoints() const { return TraceArena::View(_slot); }
 
 	// TODO State info should be added to the cursors
-	void addCursorDown(TouchPoint p) {
-		touchPoints.push_back(p);
+	void addCursorDown(const ci::tuio::Cursor& c) {
+		_append(c);
 		state = State::TOUCH_DOWN;
 	}
 
-	void cursorMove(TouchPoint p) {
-		touchPoints.push_back(p);
-		if(p.getSpeed().length() == 0) {
+	void cursorMove(const ci::tuio::Cursor& c) {
+		_append(c);
+		if(c.getSpeed().length() == 0) {
 			state = State::TOUCH_STILL;
 		} else {
 			state = State::TOUCH_MOVING;
 		}
 	}
 
-	void addCursorUp(TouchPoint p) {
-		touchPoints.push_back(p);
+	void addCursorUp(const ci::tuio::Cursor& c) {
+		_append(c);
 		state = State::TOUCH_UP;
 	}
 };
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <iterator>
+#include "TouchPoint.h"
+
+#define TRACE_CAPACITY 1024 // points kept per trace, a power of two
+
+namespace SecondStudy {
+
+	// Storage for the points of touch traces, one fixed size slot per trace, laid out
+	// as separate x, y, speed and time arrays. Slots are recycled, so once there have
+	// been as many traces around at once as there will ever be, nothing is allocated.
+	// A slot is a ring: past TRACE_CAPACITY points the oldest ones are overwritten,
+	// except for the very first, the touch down, which is always kept.
+	// Each slot also keeps the trace smoothed by a cubic B-spline, one vertex per point,
+	// ready to be drawn. Appending a point only changes the last two vertices.
+	class TraceArena {
+	public:
+		struct Slot {
+			int sessionId;
+			size_t count; // points appended so far, may well be more than TRACE_CAPACITY
+			TouchPoint first;
+			float x[TRACE_CAPACITY];
+			float y[TRACE_CAPACITY];
+			float speed[TRACE_CAPACITY];
+			double t[TRACE_CAPACITY];
+			ci::Vec2f smooth[TRACE_CAPACITY];
+		};
+
+		// Read-only window on the points of a slot, oldest first. It looks at the slot
+		// directly, so it sees points appended while it's being used, unless the owner of
+		// the slot locks them out.
+		class View {
+			const Slot* _slot;
+			size_t _count;
+
+		public:
+			class const_iterator : public std::iterator<std::random_access_iterator_tag, TouchPoint> {
+				const View* _view;
+				size_t _i;
+
+			public:
+				const_iterator(const View* view, size_t i) : _view(view), _i(i) { }
+				TouchPoint operator*() const { return (*_view)[_i]; }
+				const_iterator& operator++() { _i++; return *this; }
+				bool operator==(const const_iterator& o) const { return _i == o._i; }
+				bool operator!=(const const_iterator& o) const { return _i != o._i; }
+			};
+
+			// Takes a snapshot of how many points there are, so size() doesn't change under the caller.
+			View(const Slot* slot) : _slot(slot), _count(slot->count) { }
+
+			size_t size() const { return _count < TRACE_CAPACITY ? _count : TRACE_CAPACITY; }
+			bool empty() const { return _count == 0; }
+
+			TouchPoint operator[](size_t i) const {
+				size_t j = i;
+				if(_count > TRACE_CAPACITY) {
+					if(i == 0) {
+						return _slot->first;
+					}
+					j = (_count - TRACE_CAPACITY + i) & (TRACE_CAPACITY - 1);
+				}
+				return TouchPoint(ci::Vec2f(_slot->x[j], _slot->y[j]), _slot->speed[j], _slot->t[j]);
+			}
+
+			TouchPoint front() const { return (*this)[0]; }
+			TouchPoint back() const { return (*this)[size() - 1]; }
+
+			const_iterator begin() const { return const_iterator(this, 0); }
+			const_iterator end() const { return const_iterator(this, size()); }
+
+			// Calls f(vertices, n) for each contiguous run of the smoothed trace, oldest first:
+			// once, or up to three times when the ring has wrapped around. Then the first run
+			// is the touch down on its own and the oldest point in the ring is left out, the
+			// same points as operator[] gives.
+			template<typename F>
+			void forEachSmoothedRun(F f) const {
+				if(_count <= TRACE_CAPACITY) {
+					f(_slot->smooth, _count);
+				} else {
+					size_t oldest = _count & (TRACE_CAPACITY - 1);
+					f(&_slot->first.position, 1);
+					if(oldest + 1 < TRACE_CAPACITY) {
+						f(_slot->smooth + oldest + 1, TRACE_CAPACITY - oldest - 1);
+					}
+					if(oldest > 0) {
+						f(_slot->smooth, oldest);
+					}
+				}
+			}
+		};
+
+	private:
+		std::vector<std::unique_ptr<Slot>> _slots;
+		std::vector<Slot*> _free;
+		std::mutex _mutex;
+		std::atomic<long> _grown; // slots allocated on top of the ones made up front
+
+	public:
+		TraceArena(size_t slots) : _grown(0) {
+			_slots.reserve(slots);
+			_free.reserve(slots);
+			for(size_t i = 0; i < slots; i++) {
+				_slots.push_back(std::unique_ptr<Slot>(new Slot()));
+				_free.push_back(_slots.back().get());
+			}
+		}
+
+		// Only allocates when every slot is taken.
+		Slot* acquire(int sessionId) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			Slot* s;
+			if(_free.empty()) {
+				_slots.push_back(std::unique_ptr<Slot>(new Slot()));
+				_free.reserve(_slots.size());
+				_grown++;
+				s = _slots.back().get();
+			} else {
+				s = _free.back();
+				_free.pop_back();
+			}
+			s->sessionId = sessionId;
+			s->count = 0;
+			return s;
+		}
+
+		// How many times acquire() had to allocate, because more traces were around at
+		// once than there were slots made up front.
+		long grown() const { return _grown.load(); }
+
+		void release(Slot* s) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_free.push_back(s);
+		}
+
+		// Only the owner of the slot may append to it.
+		static void append(Slot* s, const TouchPoint& p) {
+			if(s->count == 0) {
+				s->first = p;
+			}
+			size_t j = s->count & (TRACE_CAPACITY - 1);
+			s->x[j] = p.position.x;
+			s->y[j] = p.position.y;
+			s->speed[j] = p.speed;
+			s->t[j] = p.timestamp;
+
+			// Ends are clamped to the points themselves, the rest is the usual (1 4 1)/6 of a
+			// uniform cubic B-spline at its knots: the new point only affects the one before it.
+			s->smooth[j] = p.position;
+			if(s->count >= 2) {
+				size_t k = (s->count - 1) & (TRACE_CAPACITY - 1);
+				size_t i = (s->count - 2) & (TRACE_CAPACITY - 1);
+				s->smooth[k] = (ci::Vec2f(s->x[i], s->y[i]) + ci::Vec2f(s->x[k], s->y[k]) * 4.0f + p.position) / 6.0f;
+			}
+			s->count++;
+		}
+	};
+
+	static_assert((TRACE_CAPACITY & (TRACE_CAPACITY - 1)) == 0, "TRACE_CAPACITY must be a power of two");
+
+}
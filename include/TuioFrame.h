@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include "TuioObject.h"
+
+namespace SecondStudy {
+
+	// Double buffer of the tangible events the TUIO thread hands us, so that they can be
+	// applied a whole frame at a time: the TUIO thread stages them as they come in, and
+	// take() swaps out everything staged since the last call in one go. Within a frame
+	// only the latest position of a tangible counts, an update overwrites the add or
+	// update still waiting for it. The Cinder TUIO client doesn't tell us where its
+	// frames (fseq) end, so a frame is whatever comes in between two take()s.
+	class TuioFrame {
+	public:
+		enum Type {
+			ADDED,
+			UPDATED,
+			REMOVED
+		};
+
+		struct Event {
+			Type type;
+			ci::tuio::Object object;
+
+			Event(Type t, const ci::tuio::Object& o) : type(t), object(o) { }
+		};
+
+	private:
+		std::vector<Event> _back;
+		std::unordered_map<int, size_t> _pending; // by fiducial ID, the add or update in _back an update can overwrite
+		std::mutex _mutex;
+		std::atomic<long> _staged;
+		std::atomic<long> _coalesced;
+
+	public:
+		TuioFrame() : _staged(0), _coalesced(0) { }
+
+		// From the TUIO thread
+		void stage(Type type, const ci::tuio::Object& object) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_staged.store(_staged.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			int id = object.getFiducialId();
+			auto it = _pending.find(id);
+			if(type == UPDATED && it != _pending.end()) {
+				_back[it->second].object = object;
+				_coalesced.store(_coalesced.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				return;
+			}
+			if(type == REMOVED) {
+				_pending.erase(id);
+			} else {
+				_pending[id] = _back.size();
+			}
+			_back.push_back(Event(type, object));
+		}
+
+		// Swaps everything staged so far into front, in the order it came in. front is
+		// cleared first and keeps its capacity, as does the buffer it's swapped with.
+		void take(std::vector<Event>& front) {
+			front.clear();
+			std::lock_guard<std::mutex> lock(_mutex);
+			_back.swap(front);
+			_pending.clear();
+		}
+
+		// Events staged so far, and how many of them were updates folded into an earlier one
+		long staged() const { return _staged.load(std::memory_order_relaxed); }
+		long coalesced() const { return _coalesced.load(std::memory_order_relaxed); }
+	};
+
+}
@@ -1,78 +1,241 @@
+#if defined(SECONDSTUDY_HEADLESS)
+#include "HeadlessApp.h"
+#include "Replay.h"
+#else
 #include "cinder/app/AppNative.h"
 #include "cinder/gl/gl.h"
 #include "cinder/params/Params.h"
-#include "cinder/Timeline.h"
+#include "cinder/Utilities.h"
+#include "BoardRenderer.h"
+#include "DrawBench.h"
+#endif
+#include "cinder/Vector.h"
 
+#if !defined(SECONDSTUDY_HEADLESS)
 #include "TuioClient.h"
-#include "TuioCursor.h"
-#include "OscSender.h"
 #include "OscListener.h"
+#endif
+#include "TuioCursor.h"
+#include "TuioObject.h"
 
+#include "TraceArena.h"
 #include "TouchTrace.h"
 #include "Tangible.h"
 
 #include "Gesture.h"
-#include "TapGesture.h"
-#include "StrokeGesture.h"
+#include "GestureQueue.h"
+#include "StrokePipeline.h"
+#include "SpatialGrid.h"
+#include "SegmentGrid.h"
+#include "StrokeKernel.h"
+#include "SequenceStore.h"
+#include "ProximityLinker.h"
+#include "Scheduler.h"
+#include "NoteSender.h"
+#include "StageStats.h"
+#include "StatsFile.h"
+#include "SessionLog.h"
+#include "Snapshot.h"
+#include "Deadlines.h"
+#include "SlotMap.h"
+#include "PoseFrame.h"
+#include "TuioFrame.h"
 
 #define FPS 60
+#define GESTURE_QUEUE_SIZE 64
+#define TRACE_QUEUE_SIZE 64 // finished traces waiting to be classified
+#define STROKE_THREADS 2 // recognizers run on these and the gesture thread
+// What each kind of stroke scores when it is recognized, the highest wins
+#define MUSICAL_STROKE 3.0f
+#define CONNECTION_STROKE 2.0f
+#define CUTTING_STROKE 1.0f
+#define TRACE_SLOTS 32 // traces stored up front, live or waiting to be recognised
+#define TRACE_LINGER (10.0 / FPS) // seconds a finished trace is still drawn
+#define TOUCH_LEAD (2.0f / FPS) // seconds fingers are drawn ahead, about a TUIO frame and a drawn one
+#define CONNECTION_DWELL 0.4 // seconds a finger from a tangible has to stay by another one to connect them
+#define REMOVAL_TIMEOUT 1.0 // seconds a tangible can be off the table before it leaves its sequence
+#define GRID_CELL_SIZE 0.125f
+#define LINK_THRESHOLD 0.01f
+#define BAR_LENGTH 8
+#define SCHEDULER_LOOKAHEAD 20 // ms
+#define SCHEDULER_EMIT_AHEAD 10 // ms, how early timetagged bundles go out
+#define SESSION_LOG_RECORDS 65536 // per segment, 2.5 MB
+#define SESSION_LOG_SEGMENTS 16 // how many segments are kept
+#define STATS_PERIOD 1000 // ms between rewrites of the stats file
+
+// Chatter only worth having while working on the app, compiled out of release builds
+#if defined(DEBUG) || defined(_DEBUG)
+#define DEBUG_LOG(x) console() << x << endl
+#else
+#define DEBUG_LOG(x)
+#endif
 
 using namespace ci;
+#if !defined(SECONDSTUDY_HEADLESS)
 using namespace ci::app;
+#endif
 using namespace std;
 
 namespace SecondStudy {
 
-	class TheApp : public AppNative {
+#if defined(SECONDSTUDY_HEADLESS)
+	typedef HeadlessApp AppBase;
+#else
+	typedef AppNative AppBase;
+#endif
+
+	class TheApp : public AppBase {
 		float _zoom;
 		float _scale;
 		Vec2f _s, _o, _uo;
+		// _s, _o and _scale as of the last resize, for the threads other than the main one
+		struct Screen {
+			Vec2f s, o;
+			float scale;
+
+			Screen() : scale(1.0f) { }
+			Screen(Vec2f s_, Vec2f o_, float scale_) : s(s_), o(o_), scale(scale_) { }
+		};
+		Snapshot<Screen> _screen;
+#if !defined(SECONDSTUDY_HEADLESS)
 		params::InterfaceGl _params;
+		BoardRenderer _boards;
+		StageStats _drawStats;
+		float _drawTime;
+		shared_ptr<DrawBench> _drawBench; // --bench draw, instead of the table
+#endif
 		
+#if !defined(SECONDSTUDY_HEADLESS)
 		tuio::Client _tuioClient;
+#endif
+		// Everything the TUIO client hands us, on disk. Not used headless, that's where sessions come from.
+		shared_ptr<SessionRecorder> _recorder;
 		
 		string _hostname;
 		int _port;
-		shared_ptr<osc::Sender> _sender;
+		// Not used headless either, a replay plays to nobody
+		shared_ptr<NoteSender> _sender;
 		
-		map<int, shared_ptr<Tangible>> _objects;
-		map<int, shared_ptr<TouchTrace>> _traces;
+		// _objects is the main thread's own (see commitTuioFrame()), everyone else reads the
+		// copy it publishes in _objectsSnapshot whenever a tangible is added. Tangibles never leave the map, and
+		// stay where they are on the heap: the sequences point at them.
+		// The snapshot only fixes which tangibles there are, the Tangibles themselves are
+		// shared and change in place. Off the main thread, use only what a Tangible guards
+		// itself (notes, strokes, playhead, isOn), and take poses from _poseFrames.
+		typedef SlotMap<shared_ptr<Tangible>> Objects;
+		Objects _objects;
+		Snapshot<Objects> _objectsSnapshot;
+		// Where the visible tangibles are, by fiducial ID. Kept by the main thread as it
+		// applies tangible events and published once a whole frame is in, so the other
+		// threads never see a tangible halfway through a move, or half a frame.
+		SlotMap<Tangible::Pose> _poses;
+		PosePublisher _poseFrames;
+		shared_ptr<SpatialGrid> _grid;
+		shared_ptr<SegmentGrid> _links; // the links as drawn, for cutting strokes
+		TraceArena _traceArena;
+		typedef SlotMap<shared_ptr<TouchTrace>> Traces;
+		Traces _traces;
 		mutex _tracesMutex;
-
-		list<shared_ptr<TouchTrace>> _finishedTraces;
-		list<shared_ptr<Gesture>> _gestures;
-		mutex _gesturesMutex;
+		// Armed when cursors and tangibles go away, update() only looks at the ones due
+		Deadlines<Traces::Handle> _traceDeadlines;
+		Deadlines<Traces::Handle> _dwellDeadlines; // when a finger will have dwelled long enough to connect
+		Deadlines<int> _objectDeadlines; // by fiducial ID
+		// Tangible events from the TUIO thread, applied a frame at a time by update()
+		TuioFrame _tuioFrame;
+		vector<TuioFrame::Event> _tuioEvents;
+		// Turned on or off by the gesture thread, update() puts them back in the grid at their new size
+		vector<int> _switched;
+		mutex _switchedMutex;
+
+		// Filled as cursors go away, emptied by the trace thread as fast as it can
+		typedef pair<shared_ptr<TouchTrace>, StageStats::Clock::time_point> FinishedTrace; // and when it finished
+		GestureQueue<FinishedTrace, TRACE_QUEUE_SIZE> _finishedTraces;
+		thread _traceProcessor;
+		GestureQueue<Gesture, GESTURE_QUEUE_SIZE> _gestures;
 		
 		thread _gestureProcessor;
-		bool _gestureProcessorShouldStop;
-
-		list<list<shared_ptr<Tangible>>> _sequences;
+		shared_ptr<StrokePipeline> _strokes;
+		// Only used by musicalStroke(), kept so a stroke as long as one seen before allocates nothing
+		StrokeKernel _strokeKernel;
+		vector<Vec2f> _strokeSamples;
+		vector<int> _strokeNotes;
+
+		// Writers hold _sequencesMutex and call publishSequences() after every change,
+		// readers use _sequencesSnapshot and take no lock at all.
+		// Lock order: _sequencesMutex, then _nextPlayingMutex.
+		SequenceStore _sequences;
 		mutex _sequencesMutex;
+		Snapshot<SequenceStore> _sequencesSnapshot;
+		// The from -> to links _links has, sorted, so publishSequences() only hands it what
+		// changed. Under _sequencesMutex like the store.
+		vector<pair<int, int>> _gridLinks;
+		vector<pair<int, int>> _newGridLinks;
+		shared_ptr<ProximityLinker> _linker;
+		bool _autoLink;
 
 		float _noteLength;
-		int _currentNote;
 
-		CueRef _cue;
+		atomic<bool> _editMode; // written by the main thread, read by the scheduler thread
 
-		bool _editMode;
-
-		vector<shared_ptr<Tangible>> _nowPlaying;
-		mutex _nowPlayingMutex;
-		vector<shared_ptr<Tangible>> _nextPlaying;
+		Snapshot<vector<int>> _nowPlaying; // replaced as a whole every bar
+		vector<int> _nextPlaying;
 		mutex _nextPlayingMutex;
-		CueRef _playModeTimeline;
+		// Tangibles played once from their play icon, and the column each one is at
+		vector<pair<int, int>> _oneShots;
+		mutex _oneShotsMutex;
+		vector<int> _playheads; // tangibles whose playhead was set on the last step
+		shared_ptr<Scheduler> _scheduler;
+		float _maxLateness;
+		float _traceBacklog;
+
+		// Each written by one thread only, see forEachStage()
+		StageStats _tuioStats;
+		StageStats _commitStats;
+		StageStats _traceLatency;
+		StageStats _traceStats;
+		StageStats _gestureLatency;
+		StageStats _gestureStats;
+		StageStats _musicalStats;
+		StageStats _emitStats;
+		// How far off the drawn fingers were from where they turned out to be, see LeadCheck.
+		// Sums in pixels at 480 high. A load and a store rather than an atomic add, since
+		// atomic<double> has no fetch_add: that's only safe because the TUIO thread is the
+		// one and only writer.
+		atomic<double> _leadError;
+		atomic<double> _rawError;
+		atomic<long> _leadChecks;
+		// Where they can be read from outside. Not used headless, the replay prints them.
+		shared_ptr<StatsFile> _statsFile;
 
 	public:
+		TheApp() : _traceArena(TRACE_SLOTS), _leadError(0.0), _rawError(0.0), _leadChecks(0) { }
+
 		void setup();
 		void shutdown();
 		void update();
-		void draw();
-		void resize();
 		void processGestures();
+		void processTraces();
 		void processTrace(shared_ptr<TouchTrace> t);
+
+		// Stroke recognizers, see StrokePipeline
+		StrokeMatch matchMusicalStroke(const StrokeContext& c);
+		void musicalStroke(const StrokeContext& c, const StrokeMatch& m);
+		StrokeMatch matchConnectionStroke(const StrokeContext& c);
+		void connectionStroke(const StrokeContext& c, const StrokeMatch& m);
+		StrokeMatch matchCuttingStroke(const StrokeContext& c);
+		void cuttingStroke(const StrokeContext& c, const StrokeMatch& m);
+		void connect(int id, const vector<int>& others);
+		void dropJoinedCursors(int first, int last);
+		// With _tracesMutex held
+		void followTrace(Traces::Handle h, TouchTrace& trace, Vec2f from, Vec2f to);
+		void commitDwellingTrace(TouchTrace& trace, double now);
 		
+#if !defined(SECONDSTUDY_HEADLESS)
+		void draw();
+		void resize();
 		void keyDown(KeyEvent event);
 		void mouseDown(MouseEvent event);
+#endif
 		
 		void cursorAdded(tuio::Cursor cursor);
 		void cursorUpdated(tuio::Cursor cursor);
@@ -81,20 +244,119 @@ namespace SecondStudy {
 		void objectAdded(tuio::Object object);
 		void objectUpdated(tuio::Object object);
 		void objectRemoved(tuio::Object object);
+		// On the main thread, see TuioFrame
+		void commitTuioFrame();
+		void applyObjectAdded(const tuio::Object& object);
+		void applyObjectUpdated(const tuio::Object& object);
+		void applyObjectRemoved(const tuio::Object& object);
+		void setPose(int id, const Tangible::Pose& pose);
+		// From the gesture thread, when it turns a board on or off
+		void switched(int id);
 
 		Vec2f tuioToWorld(Vec2f p);
+		Vec2f tuioToTable(Vec2f p) { return p * Vec2f(1.0f / 0.75f, 1.0f); }
 		//Vec2f worldToScreen(Vec2f p);
 		//Vec2f tuioToScreen(Vec2f p) { return worldToScreen(tuioToWorld(p)); }
 
 		vector<shared_ptr<Tangible>> getNeighbors(shared_ptr<Tangible> t);
+		// On the main thread
+		void indexTangible(const shared_ptr<Tangible>& t);
+		// With _sequencesMutex held
+		void publishSequences();
 
 		void playCycle();
+		void collectStep(int step, Scheduler::Clock::time_point when, vector<int>& notes);
+		void emitNotes(Scheduler::Clock::time_point when, const vector<int>& notes);
+
+		// Calls f(name, stats) for every stage, in pipeline order: the TUIO callbacks (on the
+		// TUIO thread), from a cursor going away to its trace classified and the classifying
+		// itself (trace thread), from there to the scene changed and the changing itself
+		// (gesture thread, musical strokes on their own) and sending notes (scheduler thread).
+		template<typename F>
+		void forEachStage(F f) const {
+			f("tuio", _tuioStats);
+			f("tuioCommit", _commitStats);
+			f("traceLatency", _traceLatency);
+			f("processTrace", _traceStats);
+			f("gestureLatency", _gestureLatency);
+			f("gesture", _gestureStats);
+			f("musicalStroke", _musicalStats);
+			f("emitNotes", _emitStats);
+		}
+		// Finished traces not classified yet
+		size_t traceBacklog() const { return _finishedTraces.size(); }
+		// Mean distance, in pixels at 480 high, from where fingers were drawn to where they were
+		// by the time it was seen: with the lead of their filters, or just as TUIO had them.
+		double leadError() const { long n = _leadChecks.load(memory_order_relaxed); return n > 0 ? _leadError.load(memory_order_relaxed) / n : 0.0; }
+		double rawError() const { long n = _leadChecks.load(memory_order_relaxed); return n > 0 ? _rawError.load(memory_order_relaxed) / n : 0.0; }
+		// Calls f(name, value) for every figure a replay can check besides the stages, see replayMain().
+		template<typename F>
+		void forEachFigure(F f) const {
+			f("leadChecks", (double)_leadChecks.load(memory_order_relaxed));
+			f("leadError", leadError());
+			f("rawError", rawError());
+		}
+#if defined(SECONDSTUDY_HEADLESS)
+		void report(ostream& out);
+#endif
 	};
 
 	void TheApp::setup() {
-		_params = params::InterfaceGl("Parameters", Vec2i(200,250));
 		_zoom = 1.0f;
+
+		// Table space is TUIO space with the aspect ratio put back, so the grid cells are square.
+		_grid = make_shared<SpatialGrid>(tuioToTable(Vec2f(1.0f, 1.0f)), GRID_CELL_SIZE);
+		_links = make_shared<SegmentGrid>(tuioToTable(Vec2f(1.0f, 1.0f)), GRID_CELL_SIZE);
+		_linker = make_shared<ProximityLinker>(LINK_THRESHOLD);
+		// Tangibles put next to each other link up on their own, strokes still win, see ProximityLinker
+		_autoLink = true;
+		_maxLateness = 0.0f;
+		_traceBacklog = 0.0f;
+
+#if !defined(SECONDSTUDY_HEADLESS)
+		_params = params::InterfaceGl("Parameters", Vec2i(200,250));
 		_params.addParam("Zoom", &_zoom, "min=0.1 max=1.0 step=0.001 precision=3");
+		_params.addParam("Auto link", &_autoLink);
+		_params.addParam("Max note lateness (ms)", &_maxLateness, "", true);
+		_params.addParam("Trace backlog", &_traceBacklog, "", true);
+		_drawTime = 0.0f;
+		_params.addParam("Mean draw time (ms)", &_drawTime, "", true);
+
+		Tangible layout;
+		if(!_boards.setup(layout)) {
+			console() << "Instanced drawing isn't available, boards won't be drawn" << endl;
+		}
+
+		const vector<string>& args = getArgs();
+		for(size_t i = 1; i + 1 < args.size(); i++) {
+			if(args[i] == "--bench" && args[i + 1] == "draw") {
+				int boards = i + 2 < args.size() ? atoi(args[i + 2].c_str()) : DRAW_BENCH_BOARDS;
+				long frames = i + 3 < args.size() ? atol(args[i + 3].c_str()) : DRAW_BENCH_FRAMES;
+				if(_boards.isReady()) {
+					_drawBench = make_shared<DrawBench>(boards, frames, Vec2f(640.0f, 480.0f), 1.0f);
+				} else {
+					console() << "Nothing to compare without instanced drawing, not running the draw bench" << endl;
+				}
+			}
+		}
+
+		_statsFile = make_shared<StatsFile>((getDocumentsDirectory() / "SecondStudy.stats").string(), chrono::milliseconds(STATS_PERIOD));
+		forEachStage([this](const char* name, const StageStats& stats) { _statsFile->add(name, stats); });
+		_statsFile->add("draw", _drawStats);
+		_statsFile->gauge("trace backlog", [this] { return (double)_finishedTraces.size(); });
+		_statsFile->gauge("gesture backlog", [this] { return (double)_gestures.size(); });
+		_statsFile->gauge("max note lateness (ms)", [this] { return _scheduler->maxLateness(); });
+		_statsFile->gauge("tangible events", [this] { return (double)_tuioFrame.staged(); });
+		_statsFile->gauge("tangible updates coalesced", [this] { return (double)_tuioFrame.coalesced(); });
+		_statsFile->gauge("finger lead error (px)", [this] { return leadError(); });
+		_statsFile->gauge("finger raw error (px)", [this] { return rawError(); });
+		_statsFile->gauge("dropped log records", [this] { return (double)_recorder->dropped(); });
+		_statsFile->gauge("trace slots allocated", [this] { return (double)_traceArena.grown(); });
+
+		_recorder = make_shared<SessionRecorder>((getDocumentsDirectory() / "SecondStudy").string(), SESSION_LOG_RECORDS, SESSION_LOG_SEGMENTS);
+		if(!_recorder->isRecording()) {
+			console() << "Can't open the session log, TUIO traffic won't be recorded" << endl;
+		}
 		
 		_tuioClient.registerCursorAdded(this, &TheApp::cursorAdded);
 		_tuioClient.registerCursorUpdated(this, &TheApp::cursorUpdated);
@@ -105,6 +367,7 @@ namespace SecondStudy {
 		_tuioClient.registerObjectRemoved(this, &TheApp::objectRemoved);
 		
 		_tuioClient.connect(); // Defaults to UDP:3333
+#endif
 		
 		setFrameRate(FPS);
 		setWindowSize(640, 480);
@@ -115,65 +378,131 @@ namespace SecondStudy {
 		_s = Vec2f(H, h);
 		_o = Vec2f((w - H)/2.0f, 0.0f);
 		_uo = Vec2f(0.0f, 0.0f);
+		_screen.publish(Screen(_s, _o, _scale));
 
-		_gestureProcessorShouldStop = false;
+		_strokes = make_shared<StrokePipeline>(STROKE_THREADS);
+		_strokes->add("musical", [this](const StrokeContext& c) { return matchMusicalStroke(c); }, [this](const StrokeContext& c, const StrokeMatch& m) { musicalStroke(c, m); });
+		_strokes->add("connection", [this](const StrokeContext& c) { return matchConnectionStroke(c); }, [this](const StrokeContext& c, const StrokeMatch& m) { connectionStroke(c, m); });
+		_strokes->add("cutting", [this](const StrokeContext& c) { return matchCuttingStroke(c); }, [this](const StrokeContext& c, const StrokeMatch& m) { cuttingStroke(c, m); });
 		_gestureProcessor = thread(bind(&TheApp::processGestures, this));
+		_traceProcessor = thread(bind(&TheApp::processTraces, this));
 
 		_noteLength = 0.25f;
-		_currentNote = 0;
 
 		_editMode = true;
 
-		_sender = make_shared<osc::Sender>();
-		_sender->setup("localhost", 3000);
+#if !defined(SECONDSTUDY_HEADLESS)
+		_sender = make_shared<NoteSender>("localhost", 3000);
+#endif
+
+		// Always ticking, so one-shots from the play icons line up with the steps
+		_scheduler = make_shared<Scheduler>(
+			[this](int step, Scheduler::Clock::time_point when, vector<int>& notes) { collectStep(step, when, notes); },
+			[this](Scheduler::Clock::time_point when, const vector<int>& notes) { emitNotes(when, notes); },
+			chrono::milliseconds(SCHEDULER_LOOKAHEAD), chrono::milliseconds(SCHEDULER_EMIT_AHEAD));
+		_scheduler->start(_noteLength);
+
+		if(_statsFile) {
+			_statsFile->start();
+		}
 	}
 
 	void TheApp::shutdown() {
-		_gestureProcessorShouldStop = true;
+#if !defined(SECONDSTUDY_HEADLESS)
+		_tuioClient.disconnect();
+#endif
+		if(_statsFile) {
+			_statsFile->stop();
+		}
+		_scheduler.reset();
+		_recorder.reset();
+		// Traces first, whatever they turn into still gets to the gesture thread
+		_finishedTraces.close();
+		_traceProcessor.join();
+		_gestures.close();
 		_gestureProcessor.join();
 	}
 	
 	void TheApp::update() {
+		commitTuioFrame();
+
+		_switchedMutex.lock();
+		vector<int> switchedIds;
+		switchedIds.swap(_switched);
+		_switchedMutex.unlock();
+		for(int id : switchedIds) {
+			const shared_ptr<Tangible>& t = _objects.at(id);
+			if(t->isVisible) {
+				indexTangible(t);
+			}
+		}
+
 		_sequencesMutex.lock();
-		_sequences.remove_if( [](list<shared_ptr<Tangible>> l) {
-			return l.empty();
-		});
+		vector<ProximityLinker::Delta> deltas;
+		vector<int> joined;
+		if(_autoLink) {
+			deltas = _linker->pass(_sequences, *_grid, 150.0f / _s.y, joined);
+		}
+		for(int id : joined) {
+			dropJoinedCursors(id, id);
+		}
+		if(!deltas.empty()) {
+			publishSequences();
+		}
 		_sequencesMutex.unlock();
+		for(auto& d : deltas) {
+			DEBUG_LOG(d.from << (d.type == ProximityLinker::Delta::LINK ? " -> " : " -/- ") << d.to);
+		}
 
+#if defined(SECONDSTUDY_HEADLESS)
+		// No scheduler thread headless, the steps go by in replay time
+		_scheduler->poll();
+#endif
+
+		double now = getElapsedSeconds();
+
+		// Finished traces have been classified already, they only stay around to be drawn
 		_tracesMutex.lock();
-		for(auto i = _traces.begin(); i != _traces.end(); ) {
-			if(!i->second->isVisible && i->second->isDead()) {
-				_finishedTraces.push_back(i->second);
-				i = _traces.erase(i);
-			} else {
-				++i;
+		Traces::Handle trace;
+		while(_dwellDeadlines.pop(now, trace)) {
+			// Gone, or moved on to another tangible since, which armed its own
+			shared_ptr<TouchTrace>* dwelling = _traces.get(trace);
+			if(dwelling != nullptr) {
+				commitDwellingTrace(**dwelling, now);
 			}
 		}
+		while(_traceDeadlines.pop(now, trace)) {
+			_traces.erase(trace);
+		}
 		_tracesMutex.unlock();
 
-		if(_finishedTraces.size() > 0) {
-			processTrace(_finishedTraces.front());
-			_finishedTraces.pop_front();
-		}
+		_maxLateness = _scheduler->maxLateness();
+		_traceBacklog = (float)_finishedTraces.size();
 
-		for(auto& o : _objects) {
-			shared_ptr<Tangible> t = o.second;
-			switch(t->object.getFiducialId()) {
+		int id;
+		while(_objectDeadlines.pop(now, id)) {
+			shared_ptr<Tangible> t = _objectsSnapshot.load()->at(id);
+			// Put back since, or taken off again later on, and then there's a later deadline.
+			// The same sum as the deadline armed in applyObjectRemoved(), so the one that
+			// is due now never looks early.
+			if(t->isVisible || t->timeRemoved + REMOVAL_TIMEOUT > now) {
+				continue;
+			}
+			switch(id) {
 			case 0: {
-				if(!t->isVisible && (getElapsedSeconds() - t->timeRemoved) > 1.0f) {
+				if(!_editMode) {
 					_editMode = true;
-					_playModeTimeline->setLoop(false);
-					_playModeTimeline->removeSelf();
+					_nowPlaying.publish(vector<int>());
 				}
 				break;
 			}
 			default: {
 				_sequencesMutex.lock();
-				for(auto& s : _sequences) {
-					s.remove_if( [this](shared_ptr<Tangible> u) {
-						return !u->isVisible && (getElapsedSeconds() - u->timeRemoved) > 1.0f;
-					});
+				if(_sequences.contains(id)) {
+					_sequences.remove(id);
+					publishSequences();
 				}
+				_linker->forget(id);
 				_sequencesMutex.unlock();
 				break;
 			}
@@ -184,69 +513,123 @@ namespace SecondStudy {
 	void TheApp::playCycle() {
 		//console() << "Play cycle" << endl;
 		_nextPlayingMutex.lock();
-		_nowPlayingMutex.lock();
-		_nowPlaying = _nextPlaying;
-		_nowPlayingMutex.unlock();
+		_nowPlaying.publish(_nextPlaying);
 
-		// for all in _nextPlaying, play them
-		for(auto t : _nowPlaying) {
-			//console() << t->object.getFiducialId() << " ";
-			// in my example (4 + 4, connect tail-head), the second iteration hits an empty pointer.
-			t->play(_noteLength);
-		}
-		console() << endl;
-		_sequencesMutex.lock();
+		// collectStep() plays whatever is in _nowPlaying from here on
+		DEBUG_LOG("");
+		shared_ptr<const SequenceStore> sequences = _sequencesSnapshot.load();
 		for(int i = 0; i < _nextPlaying.size(); i++) {
-			shared_ptr<Tangible> t = _nextPlaying[i];
-			for(auto &s : _sequences) {
-				for(auto uit = s.begin(); uit != s.end(); ++uit) {
-					shared_ptr<Tangible> u = *uit;
-					if(t == u) {
-						if(next(uit) == s.end()) {
-							_nextPlaying[i] = s.front();
-						} else {
-							_nextPlaying[i] = *(next(uit));
-						}
-					}
-				}
+			if(sequences->contains(_nextPlaying[i])) {
+				_nextPlaying[i] = sequences->successor(_nextPlaying[i]);
 			}
-			
 		}
 		// TODO change _nowPlaying upon connections and disconnections
-		_sequencesMutex.unlock();
 		_nextPlayingMutex.unlock();
 	}
 
+	// Runs on the scheduler thread, a little before the step is due.
+	void TheApp::collectStep(int step, Scheduler::Clock::time_point when, vector<int>& notes) {
+		int column = step % BAR_LENGTH;
+		if(column == 0 && !_editMode) {
+			playCycle();
+		}
+
+		shared_ptr<const Objects> objects = _objectsSnapshot.load();
+		for(int id : _playheads) {
+			objects->at(id)->playhead = -1;
+		}
+		_playheads.clear();
+
+		shared_ptr<const vector<int>> nowPlaying = _nowPlaying.load();
+		for(int id : *nowPlaying) {
+			objects->at(id)->column(column, notes);
+			_playheads.push_back(id);
+		}
+
+		_oneShotsMutex.lock();
+		for(auto it = _oneShots.begin(); it != _oneShots.end(); ) {
+			objects->at(it->first)->column(it->second, notes);
+			_playheads.push_back(it->first);
+			if(++(it->second) == BAR_LENGTH) {
+				it = _oneShots.erase(it);
+			} else {
+				++it;
+			}
+		}
+		_oneShotsMutex.unlock();
+
+		for(int id : _playheads) {
+			objects->at(id)->playhead = column;
+		}
+	}
+
+	// Runs on the scheduler thread, shortly before the step is due. The bundle says when.
+	void TheApp::emitNotes(Scheduler::Clock::time_point when, const vector<int>& notes) {
+		StageStats::Scope scope(_emitStats);
+		if(_sender) {
+			_sender->send(when, notes);
+		}
+	}
+
+#if !defined(SECONDSTUDY_HEADLESS)
 	void TheApp::draw() {
+		if(_drawBench) {
+			if(!_drawBench->frame(_boards)) {
+				_drawBench->print(console());
+				quit();
+			}
+			return;
+		}
+
+		StageStats::Scope drawScope(_drawStats);
+		_drawTime = (float)(_drawStats.mean() / 1000.0);
 		gl::clear(Color(0, 0, 0));
 		
 		_scale = getWindowHeight() / 480.0f;
 
 		Vec2f _do = _o + _uo;
 
-		_sequencesMutex.lock();
-		for(auto& s : _sequences) {
-			if(s.size() > 1) {
-				for(auto it = s.begin(); it != prev(s.end()); ++it) {
-					shared_ptr<Tangible> a = *it;
-					shared_ptr<Tangible> b = *(next(it));
-					Vec2f ap = a->object.getPos() * _s + _do;
-					Vec2f bp = b->object.getPos() * _s + _do;
-					float w = 1.0f / log(1 + ap.distance(bp) / 100.0f);
-					gl::color(w, w, w, 1.0f); // doubtfully useful on a proper video card...
-					Vec2f d(bp - ap);
-					d.normalize();
-					gl::drawVector(Vec3f(ap), Vec3f(ap + d), ap.distance(bp), _scale * w * 5.0f);
-				}
-			}
-		}
-		_sequencesMutex.unlock();
+		shared_ptr<const Objects> objects = _objectsSnapshot.load();
+		shared_ptr<const SequenceStore> sequences = _sequencesSnapshot.load();
+		sequences->forEachLink([&, this](int aid, int bid) {
+			Vec2f ap = sequences->tangible(aid)->object.getPos() * _s + _do;
+			Vec2f bp = sequences->tangible(bid)->object.getPos() * _s + _do;
+			float w = 1.0f / log(1 + ap.distance(bp) / 100.0f);
+			gl::color(w, w, w, 1.0f); // doubtfully useful on a proper video card...
+			Vec2f d(bp - ap);
+			d.normalize();
+			gl::drawVector(Vec3f(ap), Vec3f(ap + d), ap.distance(bp), _scale * w * 5.0f);
+		});
 		gl::color(1,1,1,1);
 		
-		// Draw the objects
-		for(auto object : _objects) {
-			shared_ptr<Tangible> t = object.second;
-			if(!t->isVisible) {
+		// All the boards go in one batch, see BoardRenderer
+		_boards.begin();
+		shared_ptr<const vector<int>> nowPlaying = _nowPlaying.load();
+		for(auto& object : *objects) {
+			Tangible* t = object.second.get();
+			if(!t->isVisible || object.first == 0) {
+				continue;
+			}
+			BoardRenderer::Instance i;
+			Vec2f p = t->object.getPos() * _s + _do;
+			i.x = p.x;
+			i.y = p.y;
+			i.angle = t->object.getAngle();
+			i.scale = _scale;
+			t->notesMutex.lock();
+			i.lowMask = (float)(t->notes.mask(0) | t->notes.mask(1) << 5 | t->notes.mask(2) << 10 | t->notes.mask(3) << 15);
+			i.highMask = (float)(t->notes.mask(4) | t->notes.mask(5) << 5 | t->notes.mask(6) << 10 | t->notes.mask(7) << 15);
+			t->notesMutex.unlock();
+			i.playhead = (float)t->playhead;
+			i.playing = !_editMode && find(nowPlaying->begin(), nowPlaying->end(), object.first) != nowPlaying->end() ? 1.0f : 0.0f;
+			_boards.add(i, t->isOn);
+		}
+		_boards.draw(_scale);
+
+		// The conductor
+		for(auto& object : *objects) {
+			Tangible* t = object.second.get();
+			if(!t->isVisible || object.first != 0) {
 				continue;
 			}
 
@@ -258,73 +641,8 @@ namespace SecondStudy {
 			transform.rotate(Vec3f(0.0f, 0.0f, t->object.getAngle()));
 			gl::multModelView(transform);
 
-			switch(t->object.getFiducialId()) {
-			case 0: {
-				gl::color(0.25f, 0.5f, 1.0f, 1.0f);
-				gl::drawSolidCircle(Vec2f(0,0), 30.0f*_scale);
-				break;
-			}
-			default: {
-				//gl::drawSolidRect(Rectf(-20.0f*_scale, -20.0f*_scale, 20.0f*_scale, 20.0f*_scale));
-
-				gl::color(0.2f, 0.2f, 0.2f, 1.0f);
-				gl::drawSolidCircle(Vec2f(0,0), 50.0f*_scale);
-				gl::color(1,1,1,1);
-
-				if(!_editMode) {
-					_nowPlayingMutex.lock();
-					if(find(_nowPlaying.begin(), _nowPlaying.end(), t) != _nowPlaying.end()) {
-						gl::drawStrokedCircle(Vec2f(0,0), 60.0f*_scale);
-					}
-					_nowPlayingMutex.unlock();
-				}
-
-				Rectf board = t->isOn ? t->board : t->icon;
-
-				t->notesMutex.lock();
-				pair<int, int> size = t->size();
-				ColorAf off(0.25f, 0.25f, 0.25f, 1.0f);
-				ColorAf on(0.5f, 0.5f, 0.5f, 1.0f);
-				for(int row = 0; row < size.first; row++) {
-					for(int col = 0; col < size.second; col++) {
-						if(t->notes[row][col]) {
-							gl::color(on);
-						} else {
-							gl::color(off);
-						}
-
-						Vec2f noteRectSize(board.getSize() / Vec2f(size.first, size.second));
-						Rectf noteRect(Vec2f(0.0f, 0.0f), noteRectSize);
-						gl::drawSolidRect((noteRect + noteRectSize*Vec2f(row, col) + board.getUpperLeft()) * _scale);
-						if(t->isOn) {
-							gl::color(on * 1.25f);
-							gl::drawStrokedRect((noteRect + noteRectSize*Vec2f(row, col) + board.getUpperLeft()) * _scale);
-						}
-
-						// Draw icons
-						if(t->isOn) {
-							// Draw close icon
-							Rectf closeIcon = t->closeIcon * _scale;
-							gl::drawStrokedRect(closeIcon);
-							gl::lineWidth(2.0f * _scale);
-							gl::drawLine(closeIcon.getUpperLeft() + Vec2f(5.0f, 5.0f)*_scale, closeIcon.getLowerRight() + Vec2f(-5.0f, -5.0f)*_scale);
-							gl::drawLine(closeIcon.getUpperRight() + Vec2f(-5.0f, 5.0f)*_scale, closeIcon.getLowerLeft() + Vec2f(5.0f, -5.0f)*_scale);
-							gl::lineWidth(1.0f * _scale);
-
-							Rectf playIcon = t->playIcon * _scale;
-							gl::drawStrokedRect(playIcon);
-							gl::drawSolidTriangle(playIcon.getUpperLeft() + Vec2f(5.0f, 5.0f)*_scale, playIcon.getLowerLeft() + Vec2f(5.0f, -5.0f)*_scale, playIcon.getCenter() + Vec2f(5.0f, 0.0f) * _scale);
-
-							Rectf cursor = (t->cursor + t->cursorOffset.value()) * _scale;
-							gl::drawSolidRect(cursor);
-						}
-					}
-				}
-				t->notesMutex.unlock();
-
-				break;
-			}
-			}
+			gl::color(0.25f, 0.5f, 1.0f, 1.0f);
+			gl::drawSolidCircle(Vec2f(0,0), 30.0f*_scale);
 
 			gl::color(1,1,1,1);
 
@@ -334,27 +652,58 @@ namespace SecondStudy {
 		
 		// Draws traces as they go
 		_tracesMutex.lock();
-		for(auto trace : _traces) {
-			auto touchPoints = trace.second->touchPoints;
+		for(auto& trace : _traces) {
+			TraceArena::View touchPoints = trace.second->touchPoints();
+			// Live fingers are drawn a little ahead of where TUIO last had them, see TouchFilter
+			Vec2f finger = trace.second->isVisible ? trace.second->filter.predicted(TOUCH_LEAD) : touchPoints.back().getPos();
 			
-			std::vector<Vec2f> v;
-			for(TouchPoint p : touchPoints) {
-				v.push_back(p.getPos());
-			}
-			if(v.size() > 2) {
-				BSpline2f l(v, min((int)v.size()-1, 3), false, true);
-				PolyLine2f pl;
-				for(int i = 0; i < v.size(); i++) {
-					float t = (float)i/(float)v.size();
-					pl.push_back((l.getPosition(t)*_s)+_do);
-				}
+			// The smoothed trace is kept up to date as points come in, in TUIO space:
+			// let the modelview take it to the screen and draw it as it is.
+			if(touchPoints.size() > 2) {
+				gl::pushModelView();
+				gl::translate(_do);
+				gl::scale(Vec3f(_s.x, _s.y, 1.0f));
 				glLineWidth(2.0f * _scale);
-				gl::draw(pl);
+				const Vec2f* last = nullptr;
+				touchPoints.forEachSmoothedRun([&](const Vec2f* vertices, size_t n) {
+					if(last != nullptr) {
+						// Where the ring wraps around
+						gl::drawLine(*last, vertices[0]);
+					}
+					glEnableClientState(GL_VERTEX_ARRAY);
+					glVertexPointer(2, GL_FLOAT, 0, vertices);
+					glDrawArrays(GL_LINE_STRIP, 0, (GLsizei)n);
+					glDisableClientState(GL_VERTEX_ARRAY);
+					last = vertices + n - 1;
+				});
+				gl::drawLine(*last, finger);
 				glLineWidth(1.0f * _scale);
+				gl::popModelView();
 			}
 			
-			TouchPoint p = touchPoints.back();
-			gl::drawSolidCircle((p.getPos()*_s)+_do , _zoom * _scale * 2.0f);
+			gl::drawSolidCircle((finger*_s)+_do , _zoom * _scale * 2.0f);
+
+			// What it looks like it's turning into, until the finger comes up or it's committed
+			if(trace.second->isVisible && !trace.second->isCommitted) {
+				auto source = objects->find(trace.second->source);
+				if(source != objects->end() && !trace.second->startsOnBoard) {
+					gl::color(0.4f, 0.4f, 0.4f, 1.0f);
+					gl::drawLine(source->second->object.getPos() * _s + _do, finger * _s + _do);
+					// The connection it would make, brighter the longer the finger stays
+					auto target = objects->find(trace.second->dwellTarget);
+					if(target != objects->end()) {
+						float dwell = (float)min((getElapsedSeconds() - trace.second->dwellSince) / CONNECTION_DWELL, 1.0);
+						gl::color(0.4f + 0.6f * dwell, 0.4f + 0.6f * dwell, 0.4f + 0.6f * dwell, 1.0f);
+						gl::drawLine(source->second->object.getPos() * _s + _do, target->second->object.getPos() * _s + _do);
+					}
+				}
+				int cut = trace.second->crossedLink;
+				if(cut != -1 && sequences->contains(cut) && sequences->next(cut) != -1) {
+					gl::color(1.0f, 0.25f, 0.25f, 1.0f);
+					gl::drawLine(sequences->tangible(cut)->object.getPos() * _s + _do, sequences->tangible(sequences->next(cut))->object.getPos() * _s + _do);
+				}
+				gl::color(1,1,1,1);
+			}
 		}
 		_tracesMutex.unlock();
 		
@@ -372,281 +721,304 @@ namespace SecondStudy {
 		_s.x = _s.y / 0.75f;
 		_o.x = (w-_s.x)/2.0f;
 		_o.y = 0.0f;
+		_scale = h / 480.0f;
+		_screen.publish(Screen(_s, _o, _scale));
 	}
+#endif
 
 	void TheApp::processGestures() {
-		// TODO busy waiting is for whimps. Counting semaphore or signal queue, maybe?
-		Vec2f _do;
-		while(true) {
-			_do = _o;// + _uo;
-			if(_gestureProcessorShouldStop) {
-				return;
-			}
-			if(!_gestures.empty()) {
-				_gesturesMutex.lock();
-				shared_ptr<Gesture> g = _gestures.front();
-				_gestures.pop_front();
-				_gesturesMutex.unlock();
-
-				if(dynamic_pointer_cast<TapGesture>(g) != nullptr) {
-					shared_ptr<TapGesture> tap = dynamic_pointer_cast<TapGesture>(g);
-					Vec3f p = Vec3f(tap->position.x, tap->position.y, 0.0f);
-					// See if the tap has happened inside one of the objects boxes.
-					for(auto object : _objects) {
-						shared_ptr<Tangible> t = object.second;
-						Matrix44f transform;
-						transform.translate(Vec3f(t->object.getPos()*_s+_do));
-						transform.rotate(Vec3f(0.0f, 0.0f, t->object.getAngle()));
-						Vec3f tp3 = transform.inverted().transformPoint(p);
-						// Let's see if the tap hit a box
-						Vec2f tp = Vec2f(tp3.x, tp3.y);
-						if(t->isOn) {
-							Rectf closeIcon = t->closeIcon * _scale;
-							if(closeIcon.contains(tp)) {
-								t->isOn = false;
-							}
-							Rectf playIcon = t->playIcon * _scale;
-							if(playIcon.contains(tp)) {
-								t->play(_noteLength);
-							}
-							Rectf board = t->board * _scale;
-							if(board.contains(tp)) {
-								Vec2f off = board.getCenter() - board.getSize()/2.0f;
-								tp -= off;
-								tp /= board.getSize();
-								tp *= Vec2i(t->size().first, t->size().second);
-								pair<int, int> n((int)tp.x, (int)tp.y);
-								t->toggle(n);
-								
-							}
-						}
-						if(tp.length() < 50.0f * _scale && !t->isOn) {
-							t->isOn = true;
-						}
+		Gesture g;
+		// Sleeps until processTrace() hands us something, returns when the queue is closed.
+		while(_gestures.waitPop(g)) {
+			StageStats::Clock::time_point started = StageStats::Clock::now();
+			shared_ptr<const Screen> screen = _screen.load();
+			// One whole frame of tangibles for the whole gesture, see commitTuioFrame(). Poses
+			// first: tangibles are published before their poses, so objects has every one of them.
+			shared_ptr<const PoseFrame> poses = _poseFrames.load();
+			shared_ptr<const Objects> objects = _objectsSnapshot.load();
+			switch(g.type) {
+			case Gesture::TAP: {
+				Vec2f p = g.tap.position;
+				// Only the tangibles whose bounding circle contains the tap can have been hit.
+				vector<int> hits = _grid->query((p - screen->o) / screen->s.y);
+				for(int id : hits) {
+					// The grid may be a frame ahead of the poses
+					const Tangible::Pose* pose = poses->find(id);
+					if(pose == nullptr) {
+						continue;
 					}
-				} else if(dynamic_pointer_cast<StrokeGesture>(g) != nullptr) {
-					shared_ptr<StrokeGesture> stroke = dynamic_pointer_cast<StrokeGesture>(g);
-
-					Vec3f front = Vec3f(stroke->trace.touchPoints.front().getPos() * Vec2f(getWindowSize()));
-					Vec3f back = Vec3f(stroke->trace.touchPoints.back().getPos() * Vec2f(getWindowSize()));
-
-					// safe-guard for preventing multiple stroke gestures to be recognized with the same trace
-					bool gestureRecognized = false;
-					for(auto object : _objects) {
-						shared_ptr<Tangible> tangible = object.second;
-
-						// MUSICAL STROKE
-						if(tangible->isOn) {
-							// Let's see if it's a musical stroke.
-							// Check if both front() and back() are on the same active object's box.
-							Rectf box = tangible->board*_scale;
-							Matrix44f transform;
-							transform.translate(Vec3f(tangible->object.getPos()*_s)+Vec3f(_do.x, _do.y, 0.0f));
-							transform.rotate(Vec3f(0.0f, 0.0f, tangible->object.getAngle()));
-							Vec3f tfront = transform.inverted().transformPoint(front);
-							Vec3f tback = transform.inverted().transformPoint(back);
-							if(box.contains(Vec2f(tfront.x, tfront.y)) && box.contains(Vec2f(tback.x, tback.y))) {
-								// Rejoice in happiness, it's a musical stroke!
-								gestureRecognized = true;
-
-								list<Vec2f> transformedStroke;
-
-								// Let's compute the transform that will normalise the stroke
-								// to the unit box centered in (0.5, 0.5). Heh.
-								Vec2f offset(0,0);
-								//console() << tangible->board.getSize() << tangible->board.getCenter() << endl;
-								offset += tangible->board.getCenter()/480.0f; // DA FLYIN' FUQ?
-								offset.rotate(tangible->object.getAngle());
-								offset *= Vec2f(0.75f, 1.0f);
-								offset += tangible->object.getPos();
-								
-								vector<Vec2f> qs;
-								for(auto p : stroke->trace.touchPoints) {
-									Vec2f q(p.getPos());
-									q -= offset;
-									q /= Vec2f(0.75, 1.0f);
-									q.rotate(-tangible->object.getAngle());
-									q *= Vec2f(0.75, 1.0); // DA FUQ?
-									qs.push_back(q);
-								}
-
-								vector<Vec2f> tqs;
-								for(auto p : qs) {
-									tqs.push_back(p * Vec2f(640.0f, 480.0f));
-								}
-
-								if(tqs.size() > 2) {
-									BSpline2f l(tqs, min((int)tqs.size(), 3), false, true);
-									float totalLength = l.getLength(0,1);
-									float step = sqrt(totalLength);
-									transformedStroke.push_back((l.getPosition(0.0f) / Vec2f(640.0f, 480.0f)) / ((tangible->board.getSize()/Vec2f(640.0f, 480.0f))));
-									for(float p = 0.0f; p <= totalLength; p += step) {
-										Vec2f lp(l.getPosition(l.getTime(p)));
-										lp /= Vec2f(640.0f, 480.0f);
-										transformedStroke.push_back(lp / (tangible->board.getSize()/Vec2f(640.0f, 480.0f)));
-									}
-									transformedStroke.push_back((l.getPosition(1.0f) / Vec2f(640.0f, 480.0f)) / ((tangible->board.getSize()/Vec2f(640.0f, 480.0f))));
-								}
-
-								tangible->strokesMutex.lock();
-								tangible->strokes.push_back(transformedStroke);
-								tangible->strokesMutex.unlock();
-
-								pair<int, int> size = tangible->size();
-								vector<int> notes(size.first, 1000);
-								for(auto& p : transformedStroke) {
-									Vec2i q(Vec2i(Vec2f(size.first, size.second) * (p + Vec2f(0.5f, 0.5f))));
-									if(q.x > -1 && q.x < notes.size()) {
-										notes[q.x] = min(notes[q.x], q.y);
-									}
-								}
-								for(int i = 0; i < notes.size(); i++) {
-									console() << i << ":" << notes[i] << endl;
-									if(notes[i] < 1000) {
-										tangible->toggle(pair<int, int>(i, notes[i]));
-									}
-								}
-							}
+					const shared_ptr<Tangible>& t = objects->at(id);
+					// Let's see if the tap hit a box
+					Vec2f tp = pose->toLocal(p, screen->s, screen->o, screen->scale);
+					if(t->isOn) {
+						if(t->closeIcon.contains(tp)) {
+							t->isOn = false;
+							switched(id);
 						}
-						if(gestureRecognized) {
-							goto theMoon;
+						if(t->playIcon.contains(tp)) {
+							_oneShotsMutex.lock();
+							_oneShots.push_back(make_pair(id, 0));
+							_oneShotsMutex.unlock();
 						}
-
-						// CONNECTION STROKE
-						for(auto other : _objects) {
-							if(tangible != other.second && tangible->isVisible && other.second->isVisible) {
-								shared_ptr<Tangible> otherTangible = other.second;
-								Vec2f thisPos = tangible->object.getPos() * Vec2f(getWindowSize());
-								Vec2f otherPos = otherTangible->object.getPos() * Vec2f(getWindowSize());
-								if(thisPos.distance(Vec2f(front.x, front.y)) <= _scale*50.0f && otherPos.distance(Vec2f(back.x, back.y)) <= _scale*50.0f) {
-									// We do have a legit connection stroke
-									gestureRecognized = true;
-									_sequencesMutex.lock();
-									[&]() {
-										for(auto sit = _sequences.begin(); sit != _sequences.end(); ++sit) {
-											for(auto lit = sit->begin(); lit != sit->end(); ++lit) {
-												if(*lit == tangible) {
-													// Check if otherTangible is in the same sequence, just before lit
-													for(auto i(lit); i != sit->begin(); --i) {
-														if(*i == otherTangible) {
-															return;
-														}
-													}
-													// cover the head case because of reverse iterator madness
-													if(sit->front() == otherTangible) {
-														return;
-													}
-													if(sit->front() != otherTangible) { // prevents tail-head loops
-														for(auto nsit = _sequences.begin(); nsit != _sequences.end(); ++nsit) {
-															for(auto nlit = nsit->begin(); nlit != nsit->end(); ++nlit) {
-																if(*nlit == otherTangible) {
-																	nsit->splice(nlit, *sit, sit->begin(), next(lit));
-																	// TODO some magic here to prevent double cursors
-																	// Just need to figure what's going on here exactly
-																	//_nowPlayingMutex.lock();
-																	_nextPlayingMutex.lock();
-																	for(auto it = nlit; it != nsit->end(); ++it) {
-																		//remove(_nowPlaying.begin(), _nowPlaying.end(), *it);
-																		remove(_nextPlaying.begin(), _nextPlaying.end(), *it);
-																	}
-																	_nextPlayingMutex.unlock();
-																	//_nowPlayingMutex.unlock();
-																	return;
-																}
-															}
-														}
-													}
-												}
-											}
-										}
-									}();
-									_sequencesMutex.unlock();
-								}
-							}
-						}
-						if(gestureRecognized) {
-							goto theMoon;
+						if(t->board.contains(tp)) {
+							tp -= t->board.getUpperLeft();
+							tp /= t->board.getSize();
+							tp *= Vec2i(t->size().first, t->size().second);
+							pair<int, int> n((int)tp.x, (int)tp.y);
+							t->toggle(n);
+							
 						}
+					}
+					if(tp.length() < 50.0f && !t->isOn) {
+						t->isOn = true;
+						switched(id);
+					}
+				}
+				break;
+			}
+			case Gesture::STROKE: {
+				StrokeContext c;
+				c.trace = g.stroke.trace;
+				c.objects = objects;
+				c.poses = poses;
+				c.sequences = _sequencesSnapshot.load();
+				TraceArena::View points = c.trace->touchPoints();
+				c.front = points.front().getPos() * Vec2f(getWindowSize());
+				c.back = points.back().getPos() * Vec2f(getWindowSize());
+				// Tangibles (only visible ones are indexed) within reach of either end of the stroke
+				c.underFront = _grid->nearest(tuioToTable(points.front().getPos()), 50.0f / 480.0f);
+				c.underBack = _grid->nearest(tuioToTable(points.back().getPos()), 50.0f / 480.0f);
+				points.forEachSmoothedRun([&, this](const Vec2f* vertices, size_t n) {
+					for(size_t i = 0; i < n; i++) {
+						c.path.push_back(tuioToTable(vertices[i]));
+					}
+				});
+				_strokes->run(c);
+				break;
+			}
+			case Gesture::CONNECTION: {
+				// Already known for what it is, see followTrace()
+				connect(g.connection.from, vector<int>(1, g.connection.to));
+				break;
+			}
+			default:
+				console() << "Unknown gesture..." << endl;
+				break;
+			}
+			// Done with the trace, its slot can go back to the arena
+			g.stroke.trace.reset();
+			StageStats::Clock::time_point done = StageStats::Clock::now();
+			_gestureStats.add(done - started);
+			_gestureLatency.add(done - g.classified);
+		}
+	}
 
-						// CUTTING STROKE
-						_sequencesMutex.lock();
-						[&, this]() {
-							for(auto& s : _sequences) {
-								if(s.size() > 1) {
-									for(auto it = s.begin(); it != prev(s.end()); ++it) {
-										shared_ptr<Tangible> at = *it;
-										shared_ptr<Tangible> bt = *(next(it));
-										Vec2f a = at->object.getPos() * _s + _do;
-										Vec2f b = bt->object.getPos() * _s + _do;
-										Vec2f c = Vec2f(front.x, front.y) + _uo;
-										Vec2f d = Vec2f(back.x, back.y) + _uo;
-
-										// If A1 o A2 are INF, then they are both vetical...
-										float A1 = (a.y - b.y) / (a.x - b.x);
-										float A2 = (c.y - d.y) / (c.x - d.x);
-										float b1 = a.y - A1 * a.x;
-										float b2 = c.y - A2 * c.x;
-
-										if(abs(A1 - A2) > FLT_EPSILON) {
-											float px = (b2 - b1) / (A1 - A2);
-											Vec2f p(px, A1 * px + b1);
-
-											// Now, to see if p is contained within both bounding boxes...
-											Rectf ab(min(a.x, b.x), min(a.y, b.y), max(a.x, b.x), max(a.y, b.y));
-											Rectf cd(min(c.x, d.x), min(c.y, d.y), max(c.x, d.x), max(c.y, d.y));
-											if(ab.contains(p) && cd.contains(p)) {
-												gestureRecognized = true;
-												// Now, the connection goes from a to b, so b begins a new sequence
-												console() << at->object.getFiducialId() << " -> " << bt->object.getFiducialId() << endl;
-												list<shared_ptr<Tangible>> ns;
-												ns.splice(ns.end(), s, next(it), s.end());
-												_sequences.push_back(ns);
-												_nextPlayingMutex.lock();
-												// if(find(_nowPlaying.begin(), _nowPlaying.end(), t) != _nowPlaying.end()) {
-												if(find(_nextPlaying.begin(), _nextPlaying.end(), s.front()) == _nextPlaying.end()) {
-													_nextPlaying.push_back(s.front());
-												}
-												_nextPlayingMutex.unlock();
-												return;
-											}
-										}
-									}
-								}
-							}
-						}();
-						_sequencesMutex.unlock();
+	// Both ends of the stroke on the board of a tangible that is on
+	StrokeMatch TheApp::matchMusicalStroke(const StrokeContext& c) {
+		shared_ptr<const Screen> screen = _screen.load();
+		for(size_t i = 0; i < c.poses->size(); i++) {
+			const Tangible* tangible = c.objects->at(c.poses->id(i)).get();
+			if(tangible->isOn) {
+				const Tangible::Pose& pose = (*c.poses)[i];
+				Vec2f tfront = pose.toLocal(c.front, screen->s, screen->o, screen->scale);
+				Vec2f tback = pose.toLocal(c.back, screen->s, screen->o, screen->scale);
+				if(tangible->board.contains(tfront) && tangible->board.contains(tback)) {
+					return StrokeMatch(MUSICAL_STROKE, c.poses->id(i), -1);
+				}
+			}
+		}
+		return StrokeMatch();
+	}
 
-					}
-				} else {
-					console() << "Unknown gesture..." << endl;
+	// Rejoice in happiness, it's a musical stroke! Draws it on the board and toggles the notes it goes through.
+	void TheApp::musicalStroke(const StrokeContext& c, const StrokeMatch& m) {
+		StageStats::Scope scope(_musicalStats);
+		const shared_ptr<Tangible>& tangible = c.objects->at(m.a);
+		const Tangible::Pose& pose = c.poses->at(m.a);
+		float angle = pose.angle;
+
+		// Let's compute the transform that will normalise the stroke
+		// to the unit box centered in (0.5, 0.5). Heh.
+		Vec2f offset(0,0);
+		//console() << tangible->board.getSize() << tangible->board.getCenter() << endl;
+		offset += tangible->board.getCenter()/480.0f; // DA FLYIN' FUQ?
+		offset.rotate(angle);
+		offset *= Vec2f(0.75f, 1.0f);
+		offset += pose.position;
+
+		// From TUIO space to board pixels: take the offset out, put the aspect ratio back,
+		// turn the board straight and go from heights to pixels, as one affine transform.
+		float k = 480.0f, cs = cos(angle), sn = sin(angle);
+		float t[6] = {
+			k * cs / 0.75f, k * sn, 0.0f,
+			-k * sn / 0.75f, k * cs, 0.0f
+		};
+		t[2] = -(t[0] * offset.x + t[1] * offset.y);
+		t[5] = -(t[3] * offset.x + t[4] * offset.y);
+
+		// The trace is already smoothed, see TraceArena
+		_strokeKernel.clear();
+		c.trace->touchPoints().forEachSmoothedRun([this](const Vec2f* vertices, size_t n) {
+			_strokeKernel.append(vertices, n);
+		});
+
+		pair<int, int> size = tangible->size();
+		vector<int>& notes = _strokeNotes;
+		notes.assign(size.first, 1000);
+		_strokeSamples.clear();
+		if(_strokeKernel.size() > 2) {
+			_strokeKernel.transform(t);
+			_strokeKernel.resample(sqrt(_strokeKernel.length()), tangible->board.getSize(), size.second, _strokeSamples, notes);
+		}
+
+		// The tangible keeps its own copy, one allocation for the whole stroke
+		tangible->strokesMutex.lock();
+		tangible->strokes.push_back(vector<Vec2f>(_strokeSamples.begin(), _strokeSamples.end()));
+		tangible->strokesMutex.unlock();
+
+		for(int i = 0; i < notes.size(); i++) {
+			DEBUG_LOG(i << ":" << notes[i]);
+			if(notes[i] < 1000) {
+				tangible->toggle(pair<int, int>(i, notes[i]));
+			}
+		}
+	}
+
+	// From a tangible, nearest to the front end first, to at least one other
+	StrokeMatch TheApp::matchConnectionStroke(const StrokeContext& c) {
+		for(int id : c.underFront) {
+			for(int otherId : c.underBack) {
+				if(otherId != id) {
+					return StrokeMatch(CONNECTION_STROKE, id, -1);
 				}
 			}
-			theMoon: ;
+		}
+		return StrokeMatch();
+	}
+
+	// Puts the tangible m.a right before every other one under the back end
+	void TheApp::connectionStroke(const StrokeContext& c, const StrokeMatch& m) {
+		connect(m.a, c.underBack);
+	}
+
+	// Puts the tangible id right before every one of others
+	void TheApp::connect(int id, const vector<int>& others) {
+		_sequencesMutex.lock();
+		bool changed = false;
+		for(int otherId : others) {
+			// Nothing to do if otherTangible already comes before tangible, it also prevents tail-head loops
+			if(otherId != id && _sequences.contains(id) && _sequences.contains(otherId) && !_sequences.precedes(otherId, id)) {
+				// Everything up to tangible goes right before otherTangible, what follows it is left behind
+				_sequences.moveBefore(_sequences.head(id), id, otherId);
+				_linker->linkedByHand(id, otherId);
+				dropJoinedCursors(otherId, _sequences.tail(otherId));
+				changed = true;
+			}
+		}
+		if(changed) {
+			publishSequences();
+		}
+		_sequencesMutex.unlock();
+	}
+
+	// [first, last] has just joined another sequence, which plays on from one cursor: the
+	// cursors in [first, last] go, unless the rest of the sequence has none.
+	// The caller must hold _sequencesMutex.
+	void TheApp::dropJoinedCursors(int first, int last) {
+		auto isJoined = [&](int c) {
+			for(int i = first; ; i = _sequences.next(i)) {
+				if(i == c) {
+					return true;
+				}
+				if(i == last) {
+					return false;
+				}
+			}
+		};
+		_nextPlayingMutex.lock();
+		vector<int> joined;
+		bool others = false;
+		for(int c : _nextPlaying) {
+			if(!_sequences.contains(c) || _sequences.head(c) != _sequences.head(first)) {
+				continue;
+			}
+			if(isJoined(c)) {
+				joined.push_back(c);
+			} else {
+				others = true;
+			}
+		}
+		if(others) {
+			for(int c : joined) {
+				_nextPlaying.erase(remove(_nextPlaying.begin(), _nextPlaying.end(), c), _nextPlaying.end());
+			}
+		}
+		_nextPlayingMutex.unlock();
+	}
+
+	// The first link a -> b the stroke crosses, anywhere along it
+	StrokeMatch TheApp::matchCuttingStroke(const StrokeContext& c) {
+		vector<pair<int, int>> crossed = _links->crossings(c.path);
+		if(crossed.empty()) {
+			return StrokeMatch();
+		}
+		return StrokeMatch(CUTTING_STROKE, crossed.front().first, crossed.front().second);
+	}
+
+	// The link m.a -> m.b goes, so m.b begins a new sequence
+	void TheApp::cuttingStroke(const StrokeContext& c, const StrokeMatch& m) {
+		_sequencesMutex.lock();
+		// Unless the link went away while the stroke was being recognized
+		if(_sequences.contains(m.a) && _sequences.next(m.a) == m.b) {
+			DEBUG_LOG(m.a << " -> " << m.b);
+			_sequences.cut(m.a);
+			_linker->cutByHand(m.a, m.b);
+			int head = _sequences.head(m.a);
+			_nextPlayingMutex.lock();
+			if(find(_nextPlaying.begin(), _nextPlaying.end(), head) == _nextPlaying.end()) {
+				_nextPlaying.push_back(head);
+			}
+			_nextPlayingMutex.unlock();
+			publishSequences();
+		}
+		_sequencesMutex.unlock();
+	}
+
+	void TheApp::processTraces() {
+		FinishedTrace trace;
+		// Sleeps until cursorRemoved() hands us something, returns when the queue is closed.
+		while(_finishedTraces.waitPop(trace)) {
+			{
+				StageStats::Scope scope(_traceStats);
+				processTrace(trace.first);
+			}
+			_traceLatency.add(StageStats::Clock::now() - trace.second);
+			trace.first.reset();
 		}
 	}
 
 	void TheApp::processTrace(shared_ptr<TouchTrace> trace) {
-		Vec3f front = Vec3f(trace->touchPoints.front().getPos()*_s+_o);
-		Vec3f back = Vec3f(trace->touchPoints.back().getPos()*_s+_o);
+		shared_ptr<const Screen> screen = _screen.load();
+		Vec3f front = Vec3f(trace->touchPoints().front().getPos()*screen->s+screen->o);
+		Vec3f back = Vec3f(trace->touchPoints().back().getPos()*screen->s+screen->o);
 		double d = front.distance(back);
 		if(d <= 2.0f) {
 			// This could be a tap, let's check how long it was
-			if(trace->touchPoints.back().timestamp - trace->touchPoints.front().timestamp < 1.0) {
+			if(trace->touchPoints().back().timestamp - trace->touchPoints().front().timestamp < 1.0) {
 				// If it's less than a second, there has been a tap
-				shared_ptr<TapGesture> tap(new TapGesture(Vec2f(front.x, front.y)));
-				_gesturesMutex.lock();
-				_gestures.push_back(tap);
-				_gesturesMutex.unlock();
+				if(!_gestures.push(Gesture(TapGesture(Vec2f(front.x, front.y))))) {
+					console() << "Gesture queue full, dropping tap" << endl;
+				}
 				return;
 			}
 		}
 		// If it wasn't a tap, let's treat it as a stroke and be done with it.
-		shared_ptr<StrokeGesture> stroke(new StrokeGesture(trace));
-		_gesturesMutex.lock();
-		_gestures.push_back(stroke);
-		_gesturesMutex.unlock();
+		if(!_gestures.push(Gesture(StrokeGesture(trace)))) {
+			console() << "Gesture queue full, dropping stroke" << endl;
+		}
 	}
 
+#if !defined(SECONDSTUDY_HEADLESS)
 	void TheApp::keyDown(cinder::app::KeyEvent event) {
 		switch(event.getChar()) {
 			case KeyEvent::KEY_f: {
@@ -691,10 +1063,11 @@ namespace SecondStudy {
 				break;
 			}
 			case KeyEvent::KEY_c: {
-				for(auto object : _objects) {
-					_objects[object.first]->strokesMutex.lock();
-					_objects[object.first]->strokes.clear();
-					_objects[object.first]->strokesMutex.unlock();
+				shared_ptr<const Objects> objects = _objectsSnapshot.load();
+				for(auto& object : *objects) {
+					object.second->strokesMutex.lock();
+					object.second->strokes.clear();
+					object.second->strokesMutex.unlock();
 				}
 				break;
 			}
@@ -704,73 +1077,293 @@ namespace SecondStudy {
 	void TheApp::mouseDown(cinder::app::MouseEvent event) {
 
 	}
+#endif
 
 	void TheApp::cursorAdded(tuio::Cursor cursor) {
+		StageStats::Scope scope(_tuioStats);
+		if(_recorder) {
+			_recorder->record(TuioEvent::CURSOR_ADDED, cursor);
+		}
+		// Where the trace starts decides what it may turn into, see followTrace()
+		Vec2f p = cursor.getPos();
+		vector<int> under = _grid->nearest(tuioToTable(p), 50.0f / 480.0f);
+		bool onBoard = false;
+		shared_ptr<const Screen> screen = _screen.load();
+		shared_ptr<const PoseFrame> poses = _poseFrames.load();
+		shared_ptr<const Objects> objects = _objectsSnapshot.load();
+		for(size_t i = 0; i < poses->size(); i++) {
+			const Tangible* t = objects->at(poses->id(i)).get();
+			if(t->isOn && t->board.contains((*poses)[i].toLocal(p * Vec2f(getWindowSize()), screen->s, screen->o, screen->scale))) {
+				onBoard = true;
+				break;
+			}
+		}
 		_tracesMutex.lock();
-		_traces[cursor.getSessionId()] = make_shared<TouchTrace>();
-		_traces[cursor.getSessionId()]->addCursorDown(cursor);
+		shared_ptr<TouchTrace> trace = make_shared<TouchTrace>(_traceArena, cursor.getSessionId());
+		trace->source = under.empty() ? -1 : under.front();
+		trace->startsOnBoard = onBoard;
+		trace->addCursorDown(cursor);
+		// Session IDs aren't reused, but a repeated add replaces the trace as it always did
+		_traces.erase(_traces.handle(cursor.getSessionId()));
+		_traces.insert(cursor.getSessionId(), trace);
 		_tracesMutex.unlock();
 	}
 
 	void TheApp::cursorUpdated(tuio::Cursor cursor) {
+		StageStats::Scope scope(_tuioStats);
+		if(_recorder) {
+			_recorder->record(TuioEvent::CURSOR_UPDATED, cursor);
+		}
 		_tracesMutex.lock();
-		_traces[cursor.getSessionId()]->addCursorDown(cursor);
+		Traces::Handle h = _traces.handle(cursor.getSessionId());
+		shared_ptr<TouchTrace>* found = _traces.get(h);
+		if(found == nullptr) {
+			_tracesMutex.unlock();
+			return;
+		}
+		TouchTrace& trace = **found;
+		Vec2f last = trace.touchPoints().back().getPos();
+		trace.addCursorDown(cursor);
+		Vec2f leadOff, rawOff;
+		if(trace.leadCheck.sample(trace.filter, cursor.getPos(), trace.filter.time(), TOUCH_LEAD, leadOff, rawOff)) {
+			_leadError.store(_leadError.load(memory_order_relaxed) + tuioToTable(leadOff).length() * 480.0, memory_order_relaxed);
+			_rawError.store(_rawError.load(memory_order_relaxed) + tuioToTable(rawOff).length() * 480.0, memory_order_relaxed);
+			_leadChecks.store(_leadChecks.load(memory_order_relaxed) + 1, memory_order_relaxed);
+		}
+		if(!trace.isCommitted) {
+			followTrace(h, trace, last, cursor.getPos());
+		}
 		_tracesMutex.unlock();
 	}
 
+	// Keeps up with what a live trace is turning into, as it comes in. A trace from a
+	// tangible (not from its board, that's a musical stroke) that reaches another one
+	// may be a connection, but it may as well be on its way past it, so all that's kept
+	// is which one it's by and since when. commitDwellingTrace() hands it over once it
+	// has stayed there long enough; if it's lifted there first, the stroke pipeline
+	// takes it as a connection stroke. With _tracesMutex held.
+	void TheApp::followTrace(Traces::Handle h, TouchTrace& trace, Vec2f from, Vec2f to) {
+		if(trace.crossedLink == -1) {
+			trace.crossedLink = _links->firstCrossing(tuioToTable(from), tuioToTable(to));
+		}
+		if(trace.source == -1 || trace.startsOnBoard) {
+			return;
+		}
+		int target = -1;
+		for(int id : _grid->nearest(tuioToTable(to), 50.0f / 480.0f)) {
+			if(id != trace.source) {
+				target = id;
+				break;
+			}
+		}
+		if(target != trace.dwellTarget) {
+			trace.dwellTarget = target;
+			trace.dwellSince = elapsedSeconds();
+			// A finger that holds still sends no more points, update() checks it then
+			if(target != -1) {
+				_dwellDeadlines.arm(trace.dwellSince + CONNECTION_DWELL, h);
+			}
+		}
+		commitDwellingTrace(trace, elapsedSeconds());
+	}
+
+	// Hands a live trace over as a connection once it has stayed by the tangible it
+	// reached for CONNECTION_DWELL. Called as points come in, and by update() when the
+	// deadline followTrace() armed is due, since a finger that holds still sends none.
+	void TheApp::commitDwellingTrace(TouchTrace& trace, double now) {
+		// The same sum as the deadline, so it's never a rounding error short when that's due
+		if(trace.isCommitted || !trace.isVisible || trace.dwellTarget == -1 || now < trace.dwellSince + CONNECTION_DWELL) {
+			return;
+		}
+		if(_gestures.push(Gesture(ConnectionGesture(trace.source, trace.dwellTarget)))) {
+			trace.isCommitted = true;
+		}
+	}
+
 	void TheApp::cursorRemoved(tuio::Cursor cursor) {
+		StageStats::Scope scope(_tuioStats);
+		if(_recorder) {
+			_recorder->record(TuioEvent::CURSOR_REMOVED, cursor);
+		}
 		_tracesMutex.lock();
-		_traces[cursor.getSessionId()]->addCursorUp(cursor);
-		_traces[cursor.getSessionId()]->isVisible = false;
+		Traces::Handle h = _traces.handle(cursor.getSessionId());
+		shared_ptr<TouchTrace>* found = _traces.get(h);
+		if(found == nullptr) {
+			_tracesMutex.unlock();
+			return;
+		}
+		shared_ptr<TouchTrace> trace = *found;
+		trace->addCursorUp(cursor);
+		trace->isVisible = false;
+		bool committed = trace->isCommitted;
 		_tracesMutex.unlock();
-		//_traces.erase(cursor.getSessionId());
-		// Well, that was abrupt.
+		// A committed trace has been dealt with already
+		if(!committed && !_finishedTraces.push(make_pair(trace, StageStats::Clock::now()))) {
+			console() << "Trace queue full, dropping trace" << endl;
+		}
+		_traceDeadlines.arm(getElapsedSeconds() + TRACE_LINGER, h);
 	}
 
 	void TheApp::objectAdded(tuio::Object object) {
-		if(_objects.find(object.getFiducialId()) != _objects.end()) {
-			_objects[object.getFiducialId()]->object = object;
-			_objects[object.getFiducialId()]->isVisible = true;
+		StageStats::Scope scope(_tuioStats);
+		if(_recorder) {
+			_recorder->record(TuioEvent::OBJECT_ADDED, object);
+		}
+		_tuioFrame.stage(TuioFrame::ADDED, object);
+	}
+
+	void TheApp::objectUpdated(tuio::Object object) {
+		StageStats::Scope scope(_tuioStats);
+		if(_recorder) {
+			_recorder->record(TuioEvent::OBJECT_UPDATED, object);
+		}
+		_tuioFrame.stage(TuioFrame::UPDATED, object);
+	}
+
+	void TheApp::objectRemoved(tuio::Object object) {
+		StageStats::Scope scope(_tuioStats);
+		if(_recorder) {
+			_recorder->record(TuioEvent::OBJECT_REMOVED, object);
+		}
+		_tuioFrame.stage(TuioFrame::REMOVED, object);
+	}
+
+	// Applies everything the TUIO thread said about tangibles since the last frame, in
+	// the order it said it, with the gesture thread kept out until it's all done.
+	void TheApp::commitTuioFrame() {
+		_tuioFrame.take(_tuioEvents);
+		if(_tuioEvents.empty()) {
+			return;
+		}
+		StageStats::Scope scope(_commitStats);
+		for(auto& e : _tuioEvents) {
+			switch(e.type) {
+			case TuioFrame::ADDED: applyObjectAdded(e.object); break;
+			case TuioFrame::UPDATED: applyObjectUpdated(e.object); break;
+			case TuioFrame::REMOVED: applyObjectRemoved(e.object); break;
+			}
+		}
+		_poseFrames.publish(_poses);
+	}
+
+	void TheApp::applyObjectAdded(const tuio::Object& object) {
+		shared_ptr<Tangible> t;
+		auto it = _objects.find(object.getFiducialId());
+		if(it != _objects.end()) {
+			t = it->second;
+			t->object = object;
+			t->isVisible = true;
 		} else {
-			_objects[object.getFiducialId()] = make_shared<Tangible>();
-			_objects[object.getFiducialId()]->object = object;
-			_objects[object.getFiducialId()]->sender(_sender);
+			t = make_shared<Tangible>();
+			t->object = object;
+			_objects.insert(object.getFiducialId(), t);
+			_objectsSnapshot.publish(_objects);
+		}
+		t->updateFrame();
+		setPose(object.getFiducialId(), t->pose());
+		indexTangible(t);
+		if(object.getFiducialId() != 0) {
+			_linker->moved(object.getFiducialId(), tuioToTable(t->framePosition));
 		}
 
 		if(object.getFiducialId() == 0) {
 			_editMode = false;
 			// Play mode! Set the _nextPlaying vector to contain all the sequences heads
 			_nextPlayingMutex.lock();
-			_nextPlaying.clear();
-			_sequencesMutex.lock();
-			for(auto& s : _sequences) {
-				_nextPlaying.push_back(s.front());
-			}
-			_sequencesMutex.unlock();
+			_nextPlaying = _sequencesSnapshot.load()->heads();
 			_nextPlayingMutex.unlock();
 
-			// Now get the play mode started!
-			// TODO Parametrize bar size
-			_playModeTimeline = timeline().add( bind(&TheApp::playCycle, this), timeline().getCurrentTime());
-			_playModeTimeline->setDuration(_noteLength * 8);
-			_playModeTimeline->setLoop(true);
+			// Now get the play mode started, with a bar starting right away
+			_scheduler->start(_noteLength);
 		} else {
 			_sequencesMutex.lock();
-			list<shared_ptr<Tangible>> l;
-			l.push_back(_objects[object.getFiducialId()]);
-			_sequences.push_back(l);
+			// A tangible put back before it timed out keeps its links
+			_sequences.add(object.getFiducialId(), t.get());
+			publishSequences();
 			_sequencesMutex.unlock();
 		}
 	}
 
-	void TheApp::objectUpdated(tuio::Object object) {
-		_objects[object.getFiducialId()]->object = object;
+	void TheApp::applyObjectUpdated(const tuio::Object& object) {
+		auto it = _objects.find(object.getFiducialId());
+		if(it == _objects.end()) {
+			return;
+		}
+		const shared_ptr<Tangible>& t = it->second;
+		t->object = object;
+		if(t->updateFrame()) {
+			setPose(object.getFiducialId(), t->pose());
+			indexTangible(t);
+			if(object.getFiducialId() != 0) {
+				_linker->moved(object.getFiducialId(), tuioToTable(t->framePosition));
+			}
+		}
 	}
 
-	void TheApp::objectRemoved(tuio::Object object) {
-		_objects[object.getFiducialId()]->object = object;
-		_objects[object.getFiducialId()]->isVisible = false;
-		_objects[object.getFiducialId()]->timeRemoved = getElapsedSeconds();
+	void TheApp::applyObjectRemoved(const tuio::Object& object) {
+		auto it = _objects.find(object.getFiducialId());
+		if(it == _objects.end()) {
+			return;
+		}
+		Tangible& t = *it->second;
+		t.object = object;
+		t.isVisible = false;
+		t.timeRemoved = getElapsedSeconds();
+		t.updateFrame();
+		_objectDeadlines.arm(t.timeRemoved + REMOVAL_TIMEOUT, object.getFiducialId());
+		_poses.erase(_poses.handle(object.getFiducialId()));
+		_grid->remove(object.getFiducialId());
+		_linker->removed(object.getFiducialId());
+	}
+
+	void TheApp::setPose(int id, const Tangible::Pose& pose) {
+		auto it = _poses.find(id);
+		if(it != _poses.end()) {
+			it->second = pose;
+		} else {
+			_poses.insert(id, pose);
+		}
+	}
+
+	void TheApp::switched(int id) {
+		_switchedMutex.lock();
+		_switched.push_back(id);
+		_switchedMutex.unlock();
+	}
+
+	void TheApp::indexTangible(const shared_ptr<Tangible>& t) {
+		// Boards are drawn at _scale = height/480 and table space is in heights, hence the 480.
+		_grid->insert(t->object.getFiducialId(), tuioToTable(t->framePosition), t->boundingRadius() / 480.0f);
+		_links->move(t->object.getFiducialId(), tuioToTable(t->framePosition));
+	}
+
+	void TheApp::publishSequences() {
+		_sequencesSnapshot.publish(_sequences);
+		_newGridLinks.clear();
+		_sequences.forEachLink([this](int a, int b) {
+			_newGridLinks.push_back(make_pair(a, b));
+		});
+		sort(_newGridLinks.begin(), _newGridLinks.end());
+
+		// Both are sorted by where the links start from, walk them side by side
+		auto o = _gridLinks.begin();
+		auto n = _newGridLinks.begin();
+		while(o != _gridLinks.end() || n != _newGridLinks.end()) {
+			if(n == _newGridLinks.end() || (o != _gridLinks.end() && o->first < n->first)) {
+				_links->removeLink(o->first);
+				++o;
+			} else if(o == _gridLinks.end() || n->first < o->first) {
+				_links->addLink(n->first, n->second);
+				++n;
+			} else {
+				if(o->second != n->second) {
+					_links->addLink(n->first, n->second);
+				}
+				++o;
+				++n;
+			}
+		}
+		_gridLinks.swap(_newGridLinks);
 	}
 
 	Vec2f TheApp::tuioToWorld(Vec2f p) {
@@ -779,30 +1372,59 @@ namespace SecondStudy {
 
 	vector<shared_ptr<Tangible>> TheApp::getNeighbors(shared_ptr<Tangible> t) {
 		//console() << "-- " << t->object.getFiducialId() << endl;
+		// Already sorted by distance. The threshold is 150 world units, table space is in heights.
+		vector<int> ids = _grid->nearest(tuioToTable(t->framePosition), 150.0f / _s.y, 0, t->object.getFiducialId());
+		shared_ptr<const Objects> objects = _objectsSnapshot.load();
 		vector<shared_ptr<Tangible>> v;
-		for(auto _o : _objects) {
-			if(_o.first != t->object.getFiducialId()) {
-				shared_ptr<Tangible> o = _o.second;
-				float d = tuioToWorld(t->object.getPos()).distance(tuioToWorld(o->object.getPos()));
-				//console() << tuioToWorld(t->object.getPos()) << endl << tuioToWorld(o->object.getPos()) << endl << d << endl;
-				if(d < 150.0f) {
-					v.push_back(o);
-				}
-			}
+		for(int id : ids) {
+			v.push_back(objects->at(id));
 		}
-		sort(v.begin(), v.end(),
-			[&, this](shared_ptr<Tangible> a, shared_ptr<Tangible> b) -> bool {
-				float da = tuioToWorld(t->object.getPos()).distance(tuioToWorld(a->object.getPos()));
-				float db = tuioToWorld(t->object.getPos()).distance(tuioToWorld(b->object.getPos()));
-				
-				return da < db;
-		}); // woohoo! Lambdas are awesome!
 
 		for(auto p : v) {
-			console() << p->object.getFiducialId() << " :: " << tuioToWorld(t->object.getPos()).distance(tuioToWorld(p->object.getPos())) << endl;
+			DEBUG_LOG(p->object.getFiducialId() << " :: " << tuioToWorld(t->object.getPos()).distance(tuioToWorld(p->object.getPos())));
 		}
 		return v;
 	}
+
+#if defined(SECONDSTUDY_HEADLESS)
+	// Final state of the table, meant to be diffed between versions: every sequence,
+	// head first, and the notes on every board as one hex bit mask per column. Then how
+	// many tangible events there were (see TuioFrame) and how well the fingers were drawn,
+	// see leadError().
+	void TheApp::report(ostream& out) {
+		shared_ptr<const SequenceStore> sequences = _sequencesSnapshot.load();
+		out << "sequences" << endl;
+		for(int head : sequences->heads()) {
+			out << "  ";
+			for(int i = head; i != -1; i = sequences->next(i)) {
+				out << i << (sequences->isTail(i) ? "" : " -> ");
+			}
+			out << endl;
+		}
+		out << "boards" << endl;
+		// By fiducial ID, the slot map keeps them in no particular order
+		vector<pair<int, shared_ptr<Tangible>>> objects(_objectsSnapshot.load()->begin(), _objectsSnapshot.load()->end());
+		sort(objects.begin(), objects.end(), [](const pair<int, shared_ptr<Tangible>>& a, const pair<int, shared_ptr<Tangible>>& b) { return a.first < b.first; });
+		for(auto& o : objects) {
+			if(o.first == 0) {
+				continue;
+			}
+			out << "  " << o.first << (o.second->isVisible ? "" : " (removed)") << (o.second->isOn ? " on " : " off") << " ";
+			for(int c = 0; c < Tangible::Notes::columns(); c++) {
+				out << " " << hex << o.second->notes.mask(c) << dec;
+			}
+			out << endl;
+		}
+		out << "tangible events" << endl;
+		out << "  " << _tuioFrame.staged() << " staged, " << _tuioFrame.coalesced() << " updates coalesced" << endl;
+		out << "fingers" << endl;
+		out << "  " << _leadChecks.load() << " checked, " << leadError() << " px off ahead, " << rawError() << " px off as is" << endl;
+	}
+#endif
 }
 
+#if defined(SECONDSTUDY_HEADLESS)
+SECONDSTUDY_REPLAY_MAIN( SecondStudy::TheApp, FPS )
+#else
 CINDER_APP_NATIVE( SecondStudy::TheApp, RendererGl )
+#endif